@@ -3,18 +3,25 @@
 // Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
 //
 
+#include <a21/bitmatrix.hpp>
 #include <a21/clock.hpp>
+#include <a21/compressedbitmap.hpp>
 #include <a21/debouncer.hpp>
 #include <a21/dht22.hpp>
+#include <a21/dither.hpp>
 #include <a21/ec11.hpp>
 #include <a21/eeprom.hpp>
 #include <a21/font8.hpp>
 #include <a21/font8fonts.hpp>
+#include <a21/fontn.hpp>
 #include <a21/framebuffer.hpp>
+#include <a21/grayscale.hpp>
 #include <a21/i2c.hpp>
 #include <a21/midi.hpp>
 #include <a21/pcd8544.hpp>
 #include <a21/pins.hpp>
 #include <a21/print.hpp>
 #include <a21/serial.hpp>
+#include <a21/spi.hpp>
 #include <a21/ssd1306.hpp>
+#include <a21/textlayout.hpp>
@@ -0,0 +1,95 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace a21 {
+
+/**
+ * Operations on 8x8 bit matrices stored as 8 bytes, where bit J of byte I is the element in the I-th row 
+ * and the J-th column. 
+ *
+ * This is handy to convert between the "page" layout of monochrome displays (one byte per 8-pixel column, 
+ * see Display8) and the row-major layout of most image formats (one byte per 8-pixel row), or to rotate 
+ * blocks of pixels by 90 degrees.
+ */
+class BitMatrix8 {
+  
+private:
+  
+  static inline uint32_t load(const uint8_t *p) __attribute__((always_inline)) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+  
+  static inline void store(uint8_t *p, uint32_t v) __attribute__((always_inline)) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+  }
+  
+  /** Swaps the bits selected by the mask with the ones `shift` positions higher, like in "Hacker's Delight". */
+  static inline uint32_t deltaSwap(uint32_t v, uint32_t mask, uint8_t shift) __attribute__((always_inline)) {
+    uint32_t t = (v ^ (v >> shift)) & mask;
+    return v ^ t ^ (t << shift);
+  }
+  
+public:
+  
+  /** 
+   * Transposes the matrix, i.e. bit J of byte I of the result is bit I of byte J of the source.
+   * The source and the destination can be the same. 
+   * This takes 3 rounds of "delta swaps" on two 32-bit halves of the matrix instead of a loop over all 64 bits.
+   */
+  static void transpose(const uint8_t *src, uint8_t *dst) {
+    
+    uint32_t lo = load(src);
+    uint32_t hi = load(src + 4);
+    
+    // Swap the top right and the bottom left 4x4 blocks.
+    uint32_t t = (hi ^ (lo >> 4)) & 0x0F0F0F0F;
+    hi ^= t;
+    lo ^= t << 4;
+    
+    // Swap 2x2 blocks within every 4x4 one.
+    lo = deltaSwap(lo, 0x0000CCCC, 14);
+    hi = deltaSwap(hi, 0x0000CCCC, 14);
+    
+    // And finally the individual bits within 2x2 blocks.
+    lo = deltaSwap(lo, 0x00AA00AA, 7);
+    hi = deltaSwap(hi, 0x00AA00AA, 7);
+    
+    store(dst, lo);
+    store(dst + 4, hi);
+  }
+  
+  /** 
+   * Converts 8 rows of pixels in the row-major format, where the most significant bit of every byte is the leftmost 
+   * pixel (as in PBM files, for example), into 8 columns of the page layout, where the least significant bit of every 
+   * byte is the topmost pixel.
+   */
+  static void rowsToColumns(const uint8_t *rows, uint8_t *columns) {
+    uint8_t m[8];
+    transpose(rows, m);
+    for (uint8_t i = 0; i < 8; i++) {
+      columns[i] = m[7 - i];
+    }
+  }
+  
+  /** 
+   * Rotates a block of 8 columns in the page layout by 90 degrees clockwise. 
+   */
+  static void rotateColumnsCW(const uint8_t *columns, uint8_t *result) {
+    uint8_t m[8];
+    transpose(columns, m);
+    for (uint8_t i = 0; i < 8; i++) {
+      result[i] = m[7 - i];
+    }
+  }
+};
+
+} // namespace
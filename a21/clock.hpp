@@ -28,6 +28,10 @@ public:
     return (uint16_t)::micros();
   }
   
+  static inline uint32_t millis() {
+    return ::millis();
+  }
+  
   static inline void delay(uint16_t ms) {
     ::delay(ms);
   }
@@ -0,0 +1,97 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace a21 {
+
+/**
+ * Streaming decoder of compressed monochrome bitmaps stored in the flash.
+ *
+ * The first two bytes of a bitmap are its width and height in pixels, just like with the raw bitmaps accepted by 
+ * Framebuffer::blit(). Then follows the compressed contents of (height + 7) / 8 pages of `width` bytes each 
+ * (see Display8 for the layout), as a sequence of chunks each beginning with a tag byte:
+ * - 0LLLLLLL — a literal: L + 1 bytes following the tag are copied as is;
+ * - 10LLLLLL — a run: the byte following the tag is repeated L + 2 times;
+ * - 11LLLLLL — a run of L + 1 zero bytes, nothing follows the tag.
+ * Chunks can span pages. Use `tools/a21bitmap.py` to convert images into this format.
+ *
+ * The bytes are decoded one at a time, so the bitmap can be sent directly to a display without a buffer.
+ */
+class CompressedBitmap {
+  
+private:
+  
+  const uint8_t *_src;
+  
+  /** How many bytes are left in the current chunk. */
+  uint8_t _count;
+  
+  /** True if the current chunk is a literal, otherwise _value is repeated. */
+  bool _literal;
+  uint8_t _value;
+  
+  void nextChunk() {
+    uint8_t tag = pgm_read_byte(_src++);
+    if (tag < 0x80) {
+      _literal = true;
+      _count = tag + 1;
+    } else if (tag < 0xC0) {
+      _literal = false;
+      _count = (tag & 0x3F) + 2;
+      _value = pgm_read_byte(_src++);
+    } else {
+      _literal = false;
+      _count = (tag & 0x3F) + 1;
+      _value = 0;
+    }
+  }
+  
+public:
+  
+  enum ChunkTag : uint8_t {
+    ChunkLiteral = 0x00,
+    ChunkRun = 0x80,
+    ChunkZeros = 0xC0
+  };
+  
+  CompressedBitmap(const uint8_t *bitmap) : _src(bitmap + 2), _count(0) {}
+  
+  static uint8_t width(const uint8_t *bitmap) {
+    return pgm_read_byte(bitmap);
+  }
+  
+  static uint8_t height(const uint8_t *bitmap) {
+    return pgm_read_byte(bitmap + 1);
+  }
+  
+  /** The next byte of the bitmap. Reading beyond the end of the bitmap is not checked. */
+  inline uint8_t next() {
+    if (_count == 0) {
+      nextChunk();
+    }
+    _count--;
+    return _literal ? pgm_read_byte(_src++) : _value;
+  }
+  
+  /** Skips the given number of bytes, much quicker than reading them one by one because runs are skipped at once. */
+  void skip(uint16_t length) {
+    while (length > 0) {
+      if (_count == 0) {
+        nextChunk();
+      }
+      uint8_t n = (length < _count) ? length : _count;
+      if (_literal) {
+        _src += n;
+      }
+      _count -= n;
+      length -= n;
+    }
+  }
+};
+
+} // namespace
@@ -11,6 +11,59 @@
 
 namespace a21 {
 
+/** 
+ * The response of DHT22: 16 bits of humidity and 16 bits of temperature, both multiplied by 10 and sent MSB first, 
+ * followed by 8 bits of checksum. Also the things common for the non-blocking readers.
+ */
+class DHT22Frame {
+  
+public:
+  
+  static const uint8_t Size = 5;
+  
+  /** 
+   * The edges following the release of the line: the falling one beginning the response, the rising one ending 
+   * its low part, the falling one ending its high part, then rising and falling ones around the high part 
+   * of every bit, where the duration of the high part tells the value of the bit.
+   */
+  static const uint8_t Edges = 3 + 2 * 8 * Size;
+  
+  /** The high part of a bit is about 26-28 us for 0 and 70 us for 1. */
+  static inline bool bitForDuration(uint8_t us) {
+    return us > 48;
+  }
+  
+  enum Status : uint8_t {
+    /** No reading attempts were made yet. */
+    StatusNone,
+    StatusOK,
+    /** The sensor did not respond or not all the bits were received. */
+    StatusTimeout,
+    StatusChecksumError
+  };
+  
+  /** Minimum time between the requests (and after power up), in ms. */
+  static const uint16_t MinInterval = 2000;
+  
+  /** Returns false if the checksum does not match, otherwise converts the values. */
+  static bool parse(const uint8_t *response, int16_t& temperature, uint16_t& humidity) {
+    
+    uint8_t checksum = response[0];
+    checksum += response[1]; 
+    checksum += response[2]; 
+    checksum += response[3]; 
+    if (checksum != response[4])
+      return false;
+    
+    temperature = (((uint16_t)(response[2] & 0x7F) << 8) | response[3]);
+    if (response[2] & 0x80)
+      temperature = -temperature;
+    humidity = (((uint16_t)response[0] << 8) | response[1]);
+    
+    return true;
+  }
+};
+
 /** 
  * Reads DHT22 and compatible temperature/humidity sensors connected to the given pin.
  * Should have pretty compact code (~500 bytes) because it does not use floating point even to divide by 10 here.
@@ -51,7 +104,7 @@ public:
     clock::delay(1);
     
     bool result = false;
-    uint8_t response[5];
+    uint8_t response[DHT22Frame::Size];
     
     noInterrupts();
     
@@ -90,25 +143,15 @@ public:
           if (time == 0)
             goto exit;
           
+          m <<= 1;
           if (time > 48)
             m |= 1;
-          m <<= 1;
         }
                 
         response[i] = m;
       }
       
-      uint8_t checksum = response[0];
-      checksum += response[1]; 
-      checksum += response[2]; 
-      checksum += response[3]; 
-      if (checksum == response[4]) {
-        temperature = (((uint16_t)(response[2] & 0x7F) << 8) | response[3]);
-         if (response[2] & 0x80)
-          temperature = -temperature;
-        humidity = (((uint16_t)response[0] << 8) | response[1]);
-        result = true;
-      }
+      result = DHT22Frame::parse(response, temperature, humidity);
       
     } while (0);
     
@@ -118,5 +161,397 @@ public:
     return result;
   }
 };
+
+/** 
+ * Reads DHT22 and compatible sensors without blocking and without disabling interrupts. 
+ *
+ * The request is started and the line is released from the main loop, the edges of the response are timestamped 
+ * by an interrupt handler, and the bits are decoded in the main loop again once all the edges are there.
+ * The sensor is not read more often than every MinInterval ms, as it does not allow that, 
+ * and the last good reading is available together with its age meanwhile.
+ *
+ * The sketch should call pinDidChange() from an interrupt triggered by both edges on the pin (an external 
+ * or a pin change one) and check() from the main loop as often as possible, e.g.:
+ * \code
+ * DHT22Async< FastPin<2>, false > dht22;
+ *
+ * void dht22PinDidChange() {
+ *   dht22.pinDidChange();
+ * }
+ *
+ * void setup() {
+ *   attachInterrupt(digitalPinToInterrupt(2), dht22PinDidChange, CHANGE);
+ * }
+ *
+ * void loop() {
+ *   int16_t temperature;
+ *   uint16_t humidity;
+ *   if (dht22.check() && dht22.read(temperature, humidity)) {
+ *     ...
+ *   }
+ * }
+ * \endcode
+ */
+template<typename pin, bool pullup, typename clock = ArduinoClock>
+class DHT22Async : public DHT22Frame {
+  
+private:
+  
+  static const uint8_t MaxEdges = Edges;
+  
+  enum State : uint8_t {
+    StateIdle,
+    StateRequesting,
+    StateReceiving
+  };
+  
+  State _state;
+  Status _status;
+  
+  volatile bool _capturing;
+  volatile uint8_t _edgeCount;
+  volatile uint8_t _edges[MaxEdges];
+  
+  // When the line was pulled low for the last request and when it was released.
+  uint32_t _requestTime;
+  uint32_t _releaseTime;
+  
+  bool _hasReading;
+  uint32_t _readingTime;
+  int16_t _temperature;
+  uint16_t _humidity;
+  
+  void decode() {
+    
+    if (_edgeCount < MaxEdges) {
+      _status = StatusTimeout;
+      return;
+    }
+    
+    uint8_t response[DHT22Frame::Size];
+    const volatile uint8_t *edge = _edges + 3;
+    for (uint8_t i = 0; i < sizeof(response); i++) {
+      uint8_t m = 0;
+      for (uint8_t b = 8; b > 0; b--, edge += 2) {
+        m <<= 1;
+        if (bitForDuration(edge[1] - edge[0]))
+          m |= 1;
+      }
+      response[i] = m;
+    }
+    
+    if (DHT22Frame::parse(response, _temperature, _humidity)) {
+      _hasReading = true;
+      _readingTime = _releaseTime;
+      _status = StatusOK;
+    } else {
+      _status = StatusChecksumError;
+    }
+  }
+  
+public:
+  
+  DHT22Async() 
+    : _state(StateIdle), _status(StatusNone), _capturing(false), _edgeCount(0), 
+      _requestTime(0), _releaseTime(0), _hasReading(false), _readingTime(0)
+  {}
+  
+  /** Should be called from an interrupt handler on every edge on the pin. */
+  void pinDidChange() {
+    
+    if (!_capturing)
+      return;
+    
+    uint8_t count = _edgeCount;
+    
+    // Not an edge of the response yet, the line has been just released by us.
+    if (count == 0 && pin::read())
+      return;
+    
+    if (count < MaxEdges) {
+      _edges[count] = clock::micros8();
+      _edgeCount = count + 1;
+    }
+  }
+  
+  /** 
+   * Advances the reading, should be called from the main loop. 
+   * Returns true when a reading attempt has just completed, see status() and read().
+   */
+  bool check() {
+    
+    uint32_t now = clock::millis();
+    
+    switch (_state) {
+      
+      case StateIdle:
+        if (now - _requestTime >= MinInterval) {
+          // First we pull the line low for at least 1 ms.
+          pin::setOutput();
+          pin::setLow();
+          _requestTime = now;
+          _state = StateRequesting;
+        }
+        return false;
+        
+      case StateRequesting:
+        // The next tick of millis() can be right after the request, so waiting for two.
+        if (now - _requestTime >= 2) {
+          // Then release it, the response should begin in 20-40 us.
+          _edgeCount = 0;
+          _capturing = true;
+          pin::setInput(pullup);
+          _releaseTime = now;
+          _state = StateReceiving;
+        }
+        return false;
+        
+      case StateReceiving:
+        // The response takes about 5 ms.
+        if (_edgeCount < MaxEdges && now - _releaseTime < 10)
+          return false;
+        _capturing = false;
+        _state = StateIdle;
+        decode();
+        return true;
+    }
+    
+    return false;
+  }
+  
+  /** The status of the last reading attempt. */
+  Status status() const {
+    return _status;
+  }
+  
+  /** 
+   * The last good reading, even if the last attempt failed. Both values are multiplied by 10. 
+   * Returns false if there were no good readings yet. 
+   */
+  bool read(int16_t& temperature, uint16_t& humidity) const {
+    if (!_hasReading)
+      return false;
+    temperature = _temperature;
+    humidity = _humidity;
+    return true;
+  }
+  
+  /** How long ago the last good reading was taken, in ms. */
+  uint32_t age() const {
+    return clock::millis() - _readingTime;
+  }
+};
+  
+/** 
+ * Reads up to 8 DHT22 sensors connected to the lines of a bus at the same time, so all of them take about as long 
+ * as a single one. Like DHT22Async it does not block and keeps interrupts enabled.
+ *
+ * The `bus` is PinBus-compatible with the sensors connected to its first `sensorCount` lines (the rest can be 
+ * UnusedPin). The sketch should call pinDidChange() from a pin change interrupt of the port(s) the sensors are 
+ * connected to, and check() from the main loop.
+ *
+ * All the sensors are triggered together. The bus is sampled as a whole on every interrupt and the changed lines 
+ * are decoded right there, every sensor advancing its own frame, so only a few bytes per sensor are needed 
+ * instead of a buffer of timestamps per edge. Every sensor has its own checksum, status and last good reading.
+ */
+template<typename bus, uint8_t sensorCount, bool pullup, typename clock = ArduinoClock>
+class DHT22Bus : public DHT22Frame {
+  
+private:
+  
+  static const uint8_t SensorMask = (uint8_t)((1 << sensorCount) - 1);
+  
+  enum State : uint8_t {
+    StateIdle,
+    StateRequesting,
+    StateReceiving
+  };
+  
+  /** The response of a single sensor being received. It is filled by the interrupt handler, thus volatile. */
+  struct Receiver {
+    
+    /** The number of edges received so far, Edges + 1 if the edges were out of order. */
+    volatile uint8_t edges;
+    
+    /** When the high part of the current bit began. */
+    uint8_t rise;
+    
+    volatile uint8_t frame[Size];
+    
+    void reset() {
+      edges = 0;
+      for (uint8_t i = 0; i < Size; i++) {
+        frame[i] = 0;
+      }
+    }
+    
+    void edge(uint8_t time, bool high) {
+      
+      uint8_t count = edges;
+      if (count >= Edges)
+        return;
+      
+      // The edges alternate beginning with a falling one.
+      if (high != (count & 1)) {
+        edges = Edges + 1;
+        return;
+      }
+      
+      if (count >= 3) {
+        if (high) {
+          rise = time;
+        } else {
+          volatile uint8_t *b = &frame[(count - 4) >> 4];
+          *b = (*b << 1) | bitForDuration(time - rise);
+        }
+      }
+      
+      edges = count + 1;
+    }
+  };
+  
+  struct Reading {
+    Status status;
+    bool valid;
+    uint32_t time;
+    int16_t temperature;
+    uint16_t humidity;
+  };
+  
+  State _state;
+  volatile bool _capturing;
+  volatile uint8_t _lastValue;
+  
+  uint32_t _requestTime;
+  uint32_t _releaseTime;
+  
+  Receiver _receivers[sensorCount];
+  Reading _readings[sensorCount];
+  
+  bool receivedAll() const {
+    for (uint8_t i = 0; i < sensorCount; i++) {
+      if (_receivers[i].edges < Edges)
+        return false;
+    }
+    return true;
+  }
+  
+  void decode() {
+    for (uint8_t i = 0; i < sensorCount; i++) {
+      const Receiver& r = _receivers[i];
+      Reading& reading = _readings[i];
+      uint8_t frame[Size];
+      for (uint8_t j = 0; j < Size; j++) {
+        frame[j] = r.frame[j];
+      }
+      if (r.edges != Edges) {
+        reading.status = StatusTimeout;
+      } else if (parse(frame, reading.temperature, reading.humidity)) {
+        reading.status = StatusOK;
+        reading.valid = true;
+        reading.time = _releaseTime;
+      } else {
+        reading.status = StatusChecksumError;
+      }
+    }
+  }
+  
+public:
+  
+  DHT22Bus() : _state(StateIdle), _capturing(false), _lastValue(SensorMask), _requestTime(0), _releaseTime(0) {
+    for (uint8_t i = 0; i < sensorCount; i++) {
+      _readings[i].status = StatusNone;
+      _readings[i].valid = false;
+      _readings[i].time = 0;
+    }
+  }
+  
+  /** Should be called from an interrupt handler on every edge on any of the lines of the sensors. */
+  void pinDidChange() {
+    
+    if (!_capturing)
+      return;
+    
+    uint8_t time = clock::micros8();
+    uint8_t value = bus::read();
+    uint8_t changed = (value ^ _lastValue) & SensorMask;
+    _lastValue = value;
+    
+    for (uint8_t i = 0; changed; i++, changed >>= 1, value >>= 1) {
+      if (changed & 1) {
+        _receivers[i].edge(time, value & 1);
+      }
+    }
+  }
+  
+  /** 
+   * Advances the reading of all the sensors, should be called from the main loop. 
+   * Returns true when a reading attempt has just completed, see status() and read().
+   */
+  bool check() {
+    
+    uint32_t now = clock::millis();
+    
+    switch (_state) {
+      
+      case StateIdle:
+        if (now - _requestTime >= MinInterval) {
+          // Pulling all the lines low at the same time.
+          bus::write(0);
+          bus::setOutput();
+          _requestTime = now;
+          _state = StateRequesting;
+        }
+        return false;
+        
+      case StateRequesting:
+        if (now - _requestTime >= 2) {
+          for (uint8_t i = 0; i < sensorCount; i++) {
+            _receivers[i].reset();
+          }
+          // The lines are high after the release, the first edges of the responses are falling ones.
+          _lastValue = SensorMask;
+          _capturing = true;
+          bus::setInput(pullup);
+          _releaseTime = now;
+          _state = StateReceiving;
+        }
+        return false;
+        
+      case StateReceiving:
+        if (!receivedAll() && now - _releaseTime < 10)
+          return false;
+        _capturing = false;
+        _state = StateIdle;
+        decode();
+        return true;
+    }
+    
+    return false;
+  }
+  
+  /** The status of the last reading attempt of the given sensor. */
+  Status status(uint8_t sensor) const {
+    return _readings[sensor].status;
+  }
+  
+  /** 
+   * The last good reading of the given sensor, even if the last attempt failed. Both values are multiplied by 10. 
+   * Returns false if there were no good readings yet. 
+   */
+  bool read(uint8_t sensor, int16_t& temperature, uint16_t& humidity) const {
+    const Reading& reading = _readings[sensor];
+    if (!reading.valid)
+      return false;
+    temperature = reading.temperature;
+    humidity = reading.humidity;
+    return true;
+  }
+  
+  /** How long ago the last good reading of the given sensor was taken, in ms. */
+  uint32_t age(uint8_t sensor) const {
+    return clock::millis() - _readings[sensor].time;
+  }
+};
   
 } // namepsace
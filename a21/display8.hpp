@@ -6,6 +6,9 @@
 #pragma once
 
 #include <a21/print.hpp>
+#include <a21/font8fonts.hpp>
+#include <a21/fontn.hpp>
+#include <a21/compressedbitmap.hpp>
 
 namespace a21 {
 	
@@ -48,6 +51,15 @@ public:
 	/** And don't forget to call this to finish the transfer. */
 	static void endWritingPage() {}
 	
+	/** 
+	 * True if the display can offset its contents vertically via setDisplayStartLine() and has no memory beyond 
+	 * the visible pages, so any page can be shown on top. Display8Console scrolls in hardware then.
+	 */
+	static const bool HardwareScroll = false;
+	
+	/** Shows the given row of the display memory on top, wrapping around the pages below. See HardwareScroll. */
+	static bool setDisplayStartLine(uint8_t) { return false; }
+	
 	/** @{ */
 	/** Basic direct-output routines that can be built on the above. */
 	
@@ -61,6 +73,25 @@ public:
 		T::endWritingPage();
 	}
 
+	/** 
+	 * Sends a run of bytes beginning at the given column of the page and continuing on the next pages when the end 
+	 * of the current one is reached. This is what Framebuffer expects from a display.
+	 * The pages are not clipped, so this can reach parts of the display memory which are not visible.
+	 */
+	static void writeRow(uint8_t col, uint8_t page, const uint8_t *data, uint16_t data_length) {
+		const uint8_t *src = data;
+		uint16_t left = data_length;
+		while (left > 0) {
+			T::beginWritingPage(col, page);
+			for (; col < T::Cols && left > 0; col++, left--) {
+				T::writePageByte(*src++);
+			}
+			T::endWritingPage();
+			col = 0;
+			page++;
+		}
+	}
+
 	static void clearPage(uint8_t start_col, uint8_t end_col, uint8_t page, uint8_t filler = 0) {
 		T::beginWritingPage(start_col, page);
 		for (uint8_t c = start_col; c <= end_col; c++) {
@@ -82,6 +113,81 @@ public:
 		}
 	}
 
+	/** 
+	 * Streams a bitmap stored in the flash in the page layout (the first two bytes are its width and height in pixels, 
+	 * then follow (height + 7) / 8 pages of `width` bytes each) directly to the display, no framebuffer is needed. 
+	 * The top left corner of the bitmap is placed at the given column of the given page, the parts beyond the right 
+	 * and the bottom edges of the display are clipped. The bitmap can be stretched the same way as text is 
+	 * and the `xor_mask` can be used to invert it.
+	 */
+	static void drawBitmap(
+		uint8_t col, 
+		uint8_t page, 
+		const uint8_t *bitmap, 
+		Font8::DrawingScale scale = Font8::DrawingScale1, 
+		uint8_t xor_mask = 0
+	) {
+		
+		if (col >= T::Cols)
+			return;
+		
+		const uint8_t *src = bitmap;
+		uint8_t width = pgm_read_byte(src++);
+		uint8_t pages = (pgm_read_byte(src++) + 7) >> 3;
+		
+		// Number of source columns fitting the display, the last one possibly only partially.
+		uint8_t max_width = T::Cols - col;
+		uint8_t visible_width = (max_width + scale - 1) / scale;
+		if (visible_width > width)
+			visible_width = width;
+		
+		for (uint8_t p = 0; p < pages; p++, src += width) {
+			for (uint8_t phase = 0; phase < scale; phase++) {
+				
+				uint8_t out_page = page + p * scale + phase;
+				if (out_page >= T::Pages)
+					return;
+				
+				T::beginWritingPage(col, out_page);
+				uint8_t width_left = max_width;
+				for (uint8_t c = 0; c < visible_width; c++) {
+					uint8_t b = Font8::scaledByte(phase, scale, pgm_read_byte(src + c) ^ xor_mask);
+					for (uint8_t j = 0; j < scale && width_left > 0; j++, width_left--) {
+						T::writePageByte(b);
+					}
+				}
+				T::endWritingPage();
+			}
+		}
+	}
+	
+	/** 
+	 * Streams a compressed bitmap (see CompressedBitmap) directly to the display, without decompressing it into RAM. 
+	 * The top left corner of the bitmap is placed at the given column of the given page, the parts beyond the right 
+	 * and the bottom edges of the display are clipped. Note that the bottom rows of the last page of the bitmap 
+	 * are cleared when its height is not a multiple of 8. The `xor_mask` is applied to every byte.
+	 */
+	static void drawCompressedBitmap(uint8_t col, uint8_t page, const uint8_t *bitmap, uint8_t xor_mask = 0) {
+		
+		if (col >= T::Cols)
+			return;
+		
+		CompressedBitmap decoder(bitmap);
+		
+		uint8_t width = CompressedBitmap::width(bitmap);
+		uint8_t pages = (CompressedBitmap::height(bitmap) + 7) >> 3;
+		uint8_t visible_width = (col + width > T::Cols) ? T::Cols - col : width;
+		
+		for (uint8_t p = 0; p < pages && page + p < T::Pages; p++) {
+			T::beginWritingPage(col, page + p);
+			for (uint8_t c = 0; c < visible_width; c++) {
+				T::writePageByte(decoder.next() ^ xor_mask);
+			}
+			T::endWritingPage();
+			decoder.skip(width - visible_width);
+		}
+	}
+
 	/** Renders text using given page-aligned font. */
 	static uint8_t drawText(
 		Font8::Data font, 
@@ -94,6 +200,17 @@ public:
 		return Font8::draw<T>(font, col, page, T::Cols - col, text, scale, xor_mask);
 	}
 		
+	/** Renders text using given multi-page font (see FontN), the top of the text is at the given page. */
+	static uint8_t drawTextN(
+		FontN::Data font, 
+		uint8_t col,
+		uint8_t page,
+		const char *text, 
+		const uint8_t xor_mask = 0
+	) {
+		return FontN::draw<T>(font, col, page, T::Cols - col, text, xor_mask);
+	}
+		
 	static uint8_t drawTextCentered(
 		Font8::Data font, 
 		uint8_t start_col,
@@ -125,7 +242,14 @@ class Display8Constants {
 /**
  * Turns a monochrome LCD supporting simple text output into a simple text-only display with autoscrolling ("console").
  * Note that we don't inherit Arduino's Print class to keep the compiled code size small.
- * TODO: use the Print<> template for the printing functions
+ *
+ * Only the rows modified since the last draw() are transferred, and only the part of the previously drawn text 
+ * which is longer than the new one is erased. Together with setCursor() and clearToEndOfLine() this allows to update 
+ * fields of simple status screens in place instead of clearing and reprinting everything. 
+ *
+ * When the display supports HardwareScroll, 
+ * then every row of the buffer stays in the same page of the display memory and the console is scrolled via 
+ * the start line of the display, so a new line costs a single page upload instead of the whole screen.
  */
 template<typename lcd, typename font = Font8Console>
 class Display8Console : public Print< Display8Console<lcd, font> > {
@@ -140,12 +264,32 @@ private:
 	uint8_t _col;
 	uint8_t _rowWidth;
 	uint8_t _filledRows;
-	bool _dirty;
+	
+	/** Bit N is set when row N of the buffer has to be transferred. */
+	uint8_t _dirtyRows;
+	
+	/** The row of the buffer shown on top the last time the display was scrolled, 0xFF if unknown. */
+	uint8_t _topRow;
+	
+	/** The width of the text drawn last time on every page of the display, so the stale tail can be erased. */
+	uint8_t _pageWidths[lcd::Pages];
+	
+	inline void markRowDirty(uint8_t row) {
+		_dirtyRows |= (1 << row);
+	}
+	
+	/** The row of the buffer that should be shown on top. */
+	uint8_t topRow() const {
+		int8_t row = _row - _filledRows;
+		return row < 0 ? row + lcd::Pages : row;
+	}
   
 	void _lf() {
 
 		_col = 0;
 		_rowWidth = 0;
+		
+		uint8_t top_before = topRow();
 
 		_row++;
 		if (_row >= lcd::Pages) {
@@ -158,6 +302,13 @@ private:
 		}
 		
 		_buffer[_row][_col] = 0;
+		
+		if (lcd::HardwareScroll || topRow() == top_before) {
+			markRowDirty(_row);
+		} else {
+			// Every row is going to be shown one page higher.
+			_dirtyRows = 0xFF;
+		}
 	}
   
 	void cr() {
@@ -172,25 +323,85 @@ private:
 		for (uint8_t row = 0; row < lcd::Pages; row++) {
 			_buffer[row][0] = 0;
 		}
-		_dirty = true;    
+		_dirtyRows = 0xFF;
+	}
+	
+	/** 
+	 * Prints the row of the buffer on the given page of the display and erases what is left after the last character 
+	 * from the text drawn there before.
+	 */
+	void drawRow(uint8_t row, uint8_t page) {
+		uint8_t width = lcd::drawText(font::data(), 0, page, _buffer[row]);
+		if (width < _pageWidths[page]) {
+			lcd::clearPage(width, _pageWidths[page] - 1, page);
+		}
+		_pageWidths[page] = width;
 	}
 	
 	void _draw() {
 
-		if (!_dirty)
-			return;
-
-		_dirty = false;
-
-		for (uint8_t i = 0; i < lcd::Pages; i++) {
-
-			int8_t row_index = _row - _filledRows + i;
-			if (row_index < 0)
-				row_index += lcd::Pages;
+		if (lcd::HardwareScroll) {
+			
+			// Scrolling first, so the new line appears at the bottom right away.
+			uint8_t top = topRow();
+			if (top != _topRow) {
+				lcd::setDisplayStartLine(top * 8);
+				_topRow = top;
+			}
+			
+			for (uint8_t row = 0; row < lcd::Pages; row++) {
+				if (_dirtyRows & (1 << row)) {
+					drawRow(row, row);
+				}
+			}
+			
+		} else {
+			
+			uint8_t top = topRow();
+			for (uint8_t i = 0; i < lcd::Pages; i++) {
+				uint8_t row = top + i;
+				if (row >= lcd::Pages)
+					row -= lcd::Pages;
+				if (_dirtyRows & (1 << row)) {
+					drawRow(row, i);
+				}
+			}
+		}
+		
+		_dirtyRows = 0;
+	}
 
-			// Print the row and erase the space after the last character.
-			uint8_t width = lcd::drawText(font::data(), 0, i, _buffer[row_index]);
-			lcd::fillPage(width, lcd::Cols - width, i);
+	void _setCursor(uint8_t row, uint8_t col) {
+		
+		if (row >= lcd::Pages)
+			row = lcd::Pages - 1;
+		if (col > MaxCols)
+			col = MaxCols;
+		
+		// Keeping the row shown on top the same.
+		uint8_t top = topRow();
+		_row = top + row;
+		if (_row >= lcd::Pages)
+			_row -= lcd::Pages;
+		_filledRows = row;
+		
+		// Padding with spaces when the cursor is beyond the end of the row.
+		char *s = _buffer[_row];
+		_rowWidth = 0;
+		for (_col = 0; _col < col; _col++) {
+			if (s[_col] == 0) {
+				s[_col] = ' ';
+				s[_col + 1] = 0;
+				markRowDirty(_row);
+			}
+			_rowWidth += Font8::dataForCharacter(font::data(), s[_col], NULL) + 1;
+		}
+	}
+	
+	void _clearToEndOfLine() {
+		if (_buffer[_row][_col] != 0) {
+			_buffer[_row][_col] = 0;
+			markRowDirty(_row);
 		}
 	}
 
@@ -203,10 +414,15 @@ private:
 				_lf();        
 			}
 
+			// Overwriting in place when the cursor was moved back, see setCursor().
+			bool at_end = (_buffer[_row][_col] == 0);
 			_buffer[_row][_col] = ch;
 			_col++;
-			_buffer[_row][_col] = 0;
+			if (at_end) {
+				_buffer[_row][_col] = 0;
+			}
 			_rowWidth += width + 1;
+			markRowDirty(_row);
 
 			} else if (ch == '\n') {
 				_lf();
@@ -214,8 +430,6 @@ private:
 
 			cr();      
 		}
-
-		_dirty = true;
 	}  
 
 	typedef Display8Console<lcd, font> Self;
@@ -241,14 +455,34 @@ protected:
 public:	
   
 	Display8Console() 
-		: _row(0), _col(0), _rowWidth(0), _filledRows(0)
-	{}
+		: _row(0), _col(0), _rowWidth(0), _filledRows(0), _dirtyRows(0xFF), _topRow(0xFF)
+	{
+		for (uint8_t row = 0; row < lcd::Pages; row++) {
+			_buffer[row][0] = 0;
+			// Don't know what is on the display, so the first draw() should erase the full width.
+			_pageWidths[row] = lcd::Cols;
+		}
+	}
 	
 	/** Clears the console without redrawing it on the LCD. */
 	static void clear() {
 		getSelf()._clear();
 	}
 	
+	/** 
+	 * Moves the cursor to the given character of the given row, where row 0 is the one shown on top. 
+	 * The characters printed next are going to replace the existing ones. The rows below the cursor are kept, 
+	 * but the next line feed is going to clear the row it moves to.
+	 */
+	static void setCursor(uint8_t row, uint8_t col) {
+		getSelf()._setCursor(row, col);
+	}
+	
+	/** Removes the characters of the current row starting at the cursor. */
+	static void clearToEndOfLine() {
+		getSelf()._clearToEndOfLine();
+	}
+	
 	/** Transfers the contents of the console buffer to the LCD. 
 	* Note that this is not called automatically for every print() function. */
 	static void draw() {
@@ -0,0 +1,127 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace a21 {
+
+/**
+ * Converts 8-bit grayscale pixels into the page layout of monochrome displays (see Display8 and Framebuffer), 
+ * where every byte holds a column of 8 pixels with the least significant bit being the topmost one.
+ *
+ * Pixels brighter than the threshold are set (i.e. lit on an OLED). The threshold is either fixed or taken from 
+ * an 8x8 Bayer matrix ("ordered dithering"), which allows to represent shades of gray reasonably well while 
+ * still being fast and stateless, so the image can be converted in any order, e.g. as it is coming from a sensor.
+ *
+ * To convert directly into a Framebuffer, point `page` at the corresponding byte of its `data` and then call 
+ * its markDirty() for the columns affected. The same matrix is used by `tools/a21bitmap.py --dither bayer`.
+ */
+class Dither {
+  
+public:
+  
+  enum Mode : uint8_t {
+    /** Every pixel is compared against the same threshold, the fastest. */
+    ModeThreshold,
+    /** Ordered dithering with 8x8 Bayer matrix, 65 shades of gray. */
+    ModeBayer
+  };
+  
+private:
+  
+  /** Bayer 8x8 matrix, the thresholds for the pixels are `4 * value + 2`. Stored by columns, so the 8 thresholds 
+   * of the pixels of a column of a page are next to each other. */
+  static const uint8_t *bayerColumns() {
+    static const uint8_t PROGMEM _data[] = {
+      0, 48, 12, 60, 3, 51, 15, 63,
+      32, 16, 44, 28, 35, 19, 47, 31,
+      8, 56, 4, 52, 11, 59, 7, 55,
+      40, 24, 36, 20, 43, 27, 39, 23,
+      2, 50, 14, 62, 1, 49, 13, 61,
+      34, 18, 46, 30, 33, 17, 45, 29,
+      10, 58, 6, 54, 9, 57, 5, 53,
+      42, 26, 38, 22, 41, 25, 37, 21
+    };
+    return _data;
+  }
+  
+  /** The threshold of the matrix for the pixel with the given coordinates. */
+  static inline uint8_t bayerThreshold(uint8_t x, uint8_t y) __attribute__((always_inline)) {
+    return 4 * pgm_read_byte(bayerColumns() + ((x & 7) << 3) + (y & 7)) + 2;
+  }
+  
+public:
+  
+  /** 
+   * Converts a page worth of grayscale pixels, i.e. `rows` (up to 8) rows of `width` pixels each, 
+   * packing 8 vertical pixels into every byte of the `page` in one pass. 
+   * The rows are `stride` bytes apart in the source; the bits of the missing rows (when `rows` < 8) are cleared.
+   * The matrix is aligned to the origin of the source, so neighbouring pages match seamlessly.
+   */
+  static void grayscaleToPage(
+    const uint8_t *gray, 
+    uint16_t stride, 
+    uint8_t width, 
+    uint8_t rows, 
+    uint8_t *page, 
+    Mode mode = ModeBayer,
+    uint8_t threshold = 128
+  ) {
+    
+    // Thresholds for 8 columns of 8 pixels each, copied from the flash only once.
+    uint8_t thresholds[64];
+    for (uint8_t i = 0; i < 64; i++) {
+      thresholds[i] = (mode == ModeBayer) ? bayerThreshold(i >> 3, i & 7) : threshold;
+    }
+    
+    for (uint8_t x = 0; x < width; x++) {
+      
+      const uint8_t *src = gray + x;
+      const uint8_t *t = thresholds + ((x & 7) << 3);
+      
+      uint8_t b = 0;
+      for (uint8_t i = 0, mask = 1; i < rows; i++, mask <<= 1, src += stride) {
+        if (*src > t[i])
+          b |= mask;
+      }
+      
+      page[x] = b;
+    }
+  }
+  
+  /** 
+   * Converts a single row of grayscale pixels into the corresponding bits of the `page`, handy when the pixels are 
+   * streamed row by row. The row `y` overwrites the page when y % 8 == 0 and only sets its own bits otherwise, 
+   * so the page is complete after every 8th row.
+   */
+  static void grayscaleRowToPage(
+    const uint8_t *gray, 
+    uint8_t width, 
+    uint8_t y, 
+    uint8_t *page, 
+    Mode mode = ModeBayer,
+    uint8_t threshold = 128
+  ) {
+    
+    uint8_t thresholds[8];
+    for (uint8_t i = 0; i < 8; i++) {
+      thresholds[i] = (mode == ModeBayer) ? bayerThreshold(i, y) : threshold;
+    }
+    
+    uint8_t mask = 1 << (y & 7);
+    bool first = (y & 7) == 0;
+    
+    for (uint8_t x = 0; x < width; x++) {
+      uint8_t b = first ? 0 : page[x];
+      if (gray[x] > thresholds[x & 7])
+        b |= mask;
+      page[x] = b;
+    }
+  }
+};
+
+} // namespace
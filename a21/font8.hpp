@@ -18,7 +18,16 @@ public:
 	// Typedef for a font data binary stored in the flash.
 	// 
 	// The first byte contains flags: 
-	// - currently only bit 0 is used; when set, then the font contains no lowercase English characters.
+	// - bit 0, when set, then the font contains no lowercase English characters;
+	// - bit 1, when set, then the font uses the "indexed" format described below, otherwise it's the "legacy" one;
+	// - bits 2-3 are used by taller fonts sharing the indexed or sparse format, see FontN, and are 0 for Font8;
+	// - bit 4, when set, then the font uses the "sparse" format described below (bit 1 is ignored then).
+	//
+	// The text is expected in UTF-8. The legacy and indexed fonts can have characters with code points up to U+00FF 
+	// (ASCII and Latin-1), others fall back to '?' with these, while the sparse format covers the whole Basic 
+	// Multilingual Plane.
+	//
+	// Legacy format.
 	//
 	// Next follow one or more character ranges, each with a 3 byte header:
 	// - first character in the range, f; when this is 0, then there are no character ranges following anymore;
@@ -31,19 +40,174 @@ public:
 	// - the first byte contains the actual width of the character, W, i.e. how many pixel columns the character 
 	//   should occupy when rendered on the screen, W <= N - 1.
 	// - the next (N - 1) bytes contain the actual 8-pixel-high bitmap (where only the first W bytes are used).
+	//
+	// Indexed format (see tools/a21font.py).
+	//
+	// Next follow one or more character ranges, each with a 2 byte header:
+	// - first character in the range, f; when this is 0, then there are no character ranges following anymore;
+	// - last character in the range, l.
+	// 
+	// Then follow (l - f + 2) 16-bit little-endian offsets of the bitmaps of the characters from f to l, counting 
+	// from the beginning of the font data; the last offset marks the end of the bitmap of l. The bitmaps are stored 
+	// after all the ranges without any padding, so the width of a character is the difference between the next offset 
+	// and its own one. Zero width means the character is missing in the font.
+	//
+	// Sparse format (see tools/a21font.py --sparse).
+	//
+	// The next byte is the number of character ranges, R, followed by R entries of 3 16-bit little-endian numbers:
+	// - first code point in the range, f;
+	// - last code point in the range, l;
+	// - index of the offset of f in the table of offsets.
+	// 
+	// The ranges are sorted by their code points, so they can be found via binary search.
+	// Then follows the table of offsets of all the glyphs of all the ranges, with an extra one at the end. 
+	// The offsets and the bitmaps are the same as in the indexed format.
 	typedef const uint8_t *Data;
-    
+	
+	enum Flags : uint8_t {
+		FlagUppercaseOnly = 1,
+		FlagIndexed = 2,
+		FlagSparse = 16
+	};
+	
+	/** 
+	 * The range of a sparse font the last looked up code point belonged to, so the characters of the same 
+	 * script following each other are found without searching. Should be used with a single font only.
+	 */
+	struct RangeCache {
+		
+		uint16_t first;
+		uint16_t last;
+		uint16_t index;
+		
+		RangeCache() : first(1), last(0), index(0) {}
+	};
+	
+	/** 
+	 * Decodes the next character of a UTF-8 string advancing the pointer past it; returns 0 at the end of the string
+	 * without advancing. Characters outside of the Basic Multilingual Plane and malformed sequences become U+FFFD.
+	 */
+	static uint16_t nextCodePoint(const char **text) {
+		
+		const uint8_t *src = (const uint8_t *)*text;
+		
+		uint8_t b = *src;
+		if (b < 0x80) {
+			if (b != 0)
+				src++;
+			*text = (const char *)src;
+			return b;
+		}
+		
+		src++;
+		
+		uint8_t following;
+		uint32_t result;
+		if ((b & 0xE0) == 0xC0) {
+			following = 1;
+			result = b & 0x1F;
+		} else if ((b & 0xF0) == 0xE0) {
+			following = 2;
+			result = b & 0x0F;
+		} else if ((b & 0xF8) == 0xF0) {
+			following = 3;
+			result = b & 0x07;
+		} else {
+			// A continuation byte without a lead one.
+			*text = (const char *)src;
+			return 0xFFFD;
+		}
+		
+		for (; following > 0; following--) {
+			b = *src;
+			if ((b & 0xC0) != 0x80) {
+				// Truncated, not consuming the byte, it can be the end of the string or the next character.
+				*text = (const char *)src;
+				return 0xFFFD;
+			}
+			src++;
+			result = (result << 6) | (b & 0x3F);
+		}
+		
+		*text = (const char *)src;
+		return result <= 0xFFFF ? result : 0xFFFD;
+	}
+	
 	/** 
-	 * Returns the width of the glyph corresponding to a character in the given font; if a buffer is provided, 
-	 * then copies glyph's bitmap bytes into it. 
+	 * Returns the width of the glyph corresponding to a code point in the given font and sets `bitmap` to point 
+	 * to its bitmap bytes in the flash; returns 0 if the font has no such character.
+	 * The optional `cache` speeds up lookups in sparse fonts.
 	 */
-	static uint8_t dataForCharacter(Data font, char ch, uint8_t *buffer) {
+	static uint8_t glyphForCodePoint(Data font, uint16_t code_point, const uint8_t **bitmap, RangeCache *cache = NULL) {
 
 		const uint8_t *p = font;
 
 		uint8_t options = pgm_read_byte(p++);
-		if ((options & 1) && 'a' <= ch && ch <= 'z') {
-			ch = ch - 'a' + 'A';
+		if ((options & FlagUppercaseOnly) && 'a' <= code_point && code_point <= 'z') {
+			code_point = code_point - 'a' + 'A';
+		}
+		
+		if (options & FlagSparse) {
+			
+			uint8_t count = pgm_read_byte(p++);
+			const uint8_t *offsets = p + count * 6;
+			
+			RangeCache found;
+			if (cache && cache->first <= code_point && code_point <= cache->last) {
+				found = *cache;
+			} else {
+				// Binary search for the range.
+				uint8_t low = 0;
+				uint8_t high = count;
+				while (true) {
+					if (low >= high)
+						return 0;
+					uint8_t middle = low + (high - low) / 2;
+					const uint8_t *range = p + middle * 6;
+					if (code_point < pgm_read_word(range)) {
+						high = middle;
+					} else if (code_point > pgm_read_word(range + 2)) {
+						low = middle + 1;
+					} else {
+						found.first = pgm_read_word(range);
+						found.last = pgm_read_word(range + 2);
+						found.index = pgm_read_word(range + 4);
+						break;
+					}
+				}
+				if (cache)
+					*cache = found;
+			}
+			
+			const uint8_t *entry = offsets + (found.index + code_point - found.first) * 2;
+			uint16_t offset = pgm_read_word(entry);
+			*bitmap = font + offset;
+			return pgm_read_word(entry + 2) - offset;
+		}
+		
+		if (code_point > 0xFF)
+			return 0;
+		uint8_t ch = code_point;
+		
+		if (options & FlagIndexed) {
+			
+			while (true) {
+				
+				uint8_t first = pgm_read_byte(p++);
+				if (first == 0)
+					return 0;
+				
+				uint8_t last = pgm_read_byte(p++);
+				
+				if (first <= ch && ch <= last) {
+					const uint8_t *entry = p + (ch - first) * 2;
+					uint16_t offset = pgm_read_word(entry);
+					*bitmap = font + offset;
+					return pgm_read_word(entry + 2) - offset;
+				}
+				
+				p += (last - first + 2) * 2;
+			}
 		}
 
 		while (true) {
@@ -59,41 +223,70 @@ public:
 			// Number of bytes every character in the range occupies. 
 			uint8_t bytes_per_character = pgm_read_byte(p++);
 
-			// If our character is in the range, then copy its bitmap and return.
+			// If our character is in the range, then point to its bitmap.
 			if (first <= ch && ch <= last) {
     
 				p += (ch - first) * bytes_per_character;
 
 				// The first byte of the glyph data is the actual width of the glyph.
-				uint8_t width = pgm_read_byte(p++);
-
-				// Copy the bitmap if the caller expects it.
-				if (buffer) {
-					memcpy_PF(buffer, (uint_farptr_t)p, width);
-				}
-
-			  return width;
+				*bitmap = p + 1;
+				return pgm_read_byte(p);
 			}
 
 			// Otherwise let's jump to the next range of characters.
 			p += (last + 1 - first) * bytes_per_character;      
 		}
+		
+		return 0;
+	}
+	
+	/** A shortcut for glyphForCodePoint() for single byte characters. */
+	static inline uint8_t glyphForCharacter(Data font, char ch, const uint8_t **bitmap) {
+		return glyphForCodePoint(font, (uint8_t)ch, bitmap);
+	}
+	
+	/** Like glyphForCodePoint(), but falls back to '?' when the character is missing. */
+	static uint8_t glyphOrDefault(Data font, uint16_t code_point, const uint8_t **bitmap, RangeCache *cache = NULL) {
+		uint8_t width = glyphForCodePoint(font, code_point, bitmap, cache);
+		if (width == 0 && code_point != '?')
+			width = glyphForCodePoint(font, '?', bitmap, cache);
+		return width;
+	}
+    
+	/** 
+	 * Returns the width of the glyph corresponding to a code point in the given font (or '?' if there is no such 
+	 * character); if a buffer is provided, then copies glyph's bitmap bytes into it. 
+	 */
+	static uint8_t dataForCodePoint(Data font, uint16_t code_point, uint8_t *buffer, RangeCache *cache = NULL) {
+
+		const uint8_t *bitmap;
+		uint8_t width = glyphOrDefault(font, code_point, &bitmap, cache);
+		
+		// Copy the bitmap if the caller expects it.
+		if (buffer && width > 0) {
+			memcpy_PF(buffer, (uint_farptr_t)bitmap, width);
+		}
 
-		// Not found, let's return data for sort of a default character.
-		// TODO: something we can make a parameter
-		return dataForCharacter(font, '?', buffer);
+		return width;
 	}  
+	
+	/** A shortcut for dataForCodePoint() for single byte characters. */
+	static inline uint8_t dataForCharacter(Data font, char ch, uint8_t *buffer) {
+		return dataForCodePoint(font, (uint8_t)ch, buffer);
+	}
 
 	/** 
 	 * The width of the string drawn with the given font assuming 1px spacing between characters.
+	 * No more than `length` bytes of the text are measured.
      */
-	static uint8_t textWidth(Data font, const char *text) {
+	static uint8_t textWidth(Data font, const char *text, uint8_t length = 0xFF) {
 
-		char ch;
+		RangeCache cache;
+		uint16_t ch;
 		const char *src = text;
 		uint8_t result = 0;
-		while ((ch = *src++)) {      
-			uint8_t width = dataForCharacter(font, ch, NULL);
+		while (src - text < length && (ch = nextCodePoint(&src))) {      
+			uint8_t width = dataForCodePoint(font, ch, NULL, &cache);
 			result += width + 1;
 		}
 
@@ -101,27 +294,31 @@ public:
 	}
 	
 	/** 
-	 * Returns how many characters will fit max_width pixels without clipping. 
+	 * Returns how many bytes of the text will fit max_width pixels without clipping, setting `actual_width` 
+	 * to their width, if provided. 
 	 */
 	static uint8_t numberOfCharsFittingWidth(Data font, const char *text, uint8_t max_width, uint8_t *actual_width) {
   
-		uint8_t result = 0;
-
-		char ch;
+		RangeCache cache;
+		uint16_t ch;
 		const char *src = text;
+		const char *end = text;
 		uint8_t total_width = 0;
-		while ((ch = *src++)) {
+		while ((ch = nextCodePoint(&src))) {
 			
-			uint8_t new_total_width = total_width + dataForCharacter(font, ch, NULL) + 1;
+			uint16_t new_total_width = total_width + dataForCodePoint(font, ch, NULL, &cache) + 1;
 			
 			if (new_total_width > max_width)
 				break;
 			
 			total_width = new_total_width;
-			result++;
+			end = src;
 		}
+		
+		if (actual_width)
+			*actual_width = total_width;
 
-		return result;
+		return end - text;
 	}
 	
 	typedef enum : uint8_t {
@@ -136,6 +333,8 @@ public:
 	 * supporting Display8RowOutput protocol (see the corresponding prototype).
 	 * The `max_width` tells how many bytes we are allowed to output.
 	 * The `xor_mask` is XORed with every character and when set to 0xFF or 0x7E can be used to render inverted text.
+	 * No more than `length` characters of the text are drawn.
+	 * Returns the number of bytes written to every page.
 	 */
 	template<class MonochromeDisplayPageOutput>
 	static uint8_t draw(
@@ -145,98 +344,176 @@ public:
 		uint8_t max_width, 
 		const char *text, 
 		DrawingScale scale = DrawingScale1,
-		uint8_t xor_mask = 0
+		uint8_t xor_mask = 0,
+		uint8_t length = 0xFF
 	) {		
-		uint8_t result;
-		for (uint8_t phase = 0; phase < scale; phase++) {
-			result = drawPhase<MonochromeDisplayPageOutput>(phase, scale, font, col, page, max_width, text, xor_mask);
+		if (scale == DrawingScale1)
+			return drawUnscaled<MonochromeDisplayPageOutput>(font, col, page, max_width, text, xor_mask, length);
+		
+		// The source columns of the text are collected once and then stretched into every page.
+		// A chunk covers the whole width of 128px displays at 2x.
+		const uint8_t MaxColumns = 64;
+		uint8_t columns[MaxColumns];
+		
+		RangeCache cache;
+		const char *src = text;
+		const uint8_t *bitmap = NULL;
+		uint8_t glyph_width = 0;
+		// The next column of the current glyph, glyph_width stands for the spacing after it, 0xFF for no glyph.
+		uint8_t glyph_col = 0xFF;
+		
+		uint8_t width_left = max_width;
+		
+		while (width_left > 0) {
+			
+			uint8_t n = 0;
+			while (n < MaxColumns && n * scale < width_left) {
+				
+				if (glyph_col == 0xFF) {
+					if (src - text >= length)
+						break;
+					uint16_t ch = nextCodePoint(&src);
+					if (!ch)
+						break;
+					glyph_width = glyphOrDefault(font, ch, &bitmap, &cache);
+					glyph_col = 0;
+				}
+				
+				if (glyph_col < glyph_width) {
+					columns[n++] = pgm_read_byte(bitmap + glyph_col++) ^ xor_mask;
+				} else {
+					columns[n++] = xor_mask;
+					glyph_col = 0xFF;
+				}
+			}
+			
+			if (n == 0)
+				break;
+			
+			uint8_t chunk_width = (n * scale < width_left) ? n * scale : width_left;
+			
+			for (uint8_t phase = 0; phase < scale; phase++) {
+				MonochromeDisplayPageOutput::beginWritingPage(col, page + phase);
+				uint8_t left = chunk_width;
+				for (uint8_t i = 0; i < n; i++) {
+					uint8_t b = scaledByte(phase, scale, columns[i]);
+					for (uint8_t j = 0; j < scale && left > 0; j++, left--) {
+						MonochromeDisplayPageOutput::writePageByte(b);
+					}
+				}
+				MonochromeDisplayPageOutput::endWritingPage();
+			}
+			
+			col += chunk_width;
+			width_left -= chunk_width;
 		}
-		return result;
+		
+		return max_width - width_left;
 	}   
 
+	/** 
+	 * A column of glyph's pixels stretched vertically according to the scale. 
+	 * The result has 8 * scale meaningful bits with the least significant one corresponding to the topmost pixel.
+	 */
+	static uint32_t scaledColumn(DrawingScale scale, uint8_t b) {
+		uint32_t result = 0;
+		for (uint8_t phase = scale; phase > 0; phase--) {
+			result = (result << 8) | scaledByte(phase - 1, scale, b);
+		}
+		return result;
+	}
+
 protected:
 	
-	template<uint8_t bit, uint8_t phase, uint8_t scale>
-	static inline uint8_t stretched(uint8_t b) {
-		const uint8_t src_bit = (bit + phase * 8) / scale;
-		return ((b & (1 << src_bit)) >> src_bit) << bit;
+	/** 
+	 * Every nibble of a byte stretched 2x, every bit occupying 2 bits. 
+	 * Phase 0 of a 2x-scaled byte is the entry for its lower nibble, phase 1 for its higher one.
+	 */
+	static const uint8_t *scale2Table() {
+		static const uint8_t PROGMEM _table[] = {
+			0, 3, 12, 15, 48, 51, 60, 63, 192, 195, 204, 207, 240, 243, 252, 255
+		};
+		return _table;
 	}
 	
-	template<uint8_t phase, uint8_t scale>
-	static inline uint8_t stretchedByte(uint8_t b) {
-		return stretched<0, phase, scale>(b)
-			| stretched<1, phase, scale>(b)
-			| stretched<2, phase, scale>(b)
-			| stretched<3, phase, scale>(b)
-			| stretched<4, phase, scale>(b)
-			| stretched<5, phase, scale>(b)
-			| stretched<6, phase, scale>(b)
-			| stretched<7, phase, scale>(b);
-	}	
-		
+	/** 
+	 * Parts of a byte stretched 3x into 24 bits: 8 entries for phase 0 indexed by bits 0-2, 16 entries 
+	 * for phase 1 indexed by bits 2-5 and 8 entries for phase 2 indexed by bits 5-7.
+	 */
+	static const uint8_t *scale3Table() {
+		static const uint8_t PROGMEM _table[] = {
+			0, 7, 56, 63, 192, 199, 248, 255,
+			0, 1, 14, 15, 112, 113, 126, 127, 128, 129, 142, 143, 240, 241, 254, 255,
+			0, 3, 28, 31, 224, 227, 252, 255
+		};
+		return _table;
+	}
+	
+	/** Pairs of bits stretched 4x. */
+	static const uint8_t *scale4Table() {
+		static const uint8_t PROGMEM _table[] = { 0x00, 0x0F, 0xF0, 0xFF };
+		return _table;
+	}
+	
+public:
+	
+	/** 
+	 * One of `scale` bytes a byte of a glyph turns into when stretched vertically, 
+	 * `phase` being the index of the page the result belongs to. A single lookup in the flash for every scale.
+	 */
 	static uint8_t scaledByte(uint8_t phase, DrawingScale scale, uint8_t b) {
 		
 		switch (scale) {
 			case DrawingScale1:
 				return b;
 			case DrawingScale2:
-				if (phase == 0) {
-					return stretchedByte<0, 2>(b);
-				} else {
-					return stretchedByte<1, 2>(b);
-				}
+				return pgm_read_byte(scale2Table() + (phase ? (b >> 4) : (b & 0x0F)));
 			case DrawingScale3:
 				if (phase == 0) {
-					return stretchedByte<0, 3>(b);
+					return pgm_read_byte(scale3Table() + (b & 0x07));
 				} else if (phase == 1) {
-					return stretchedByte<1, 3>(b);
+					return pgm_read_byte(scale3Table() + 8 + ((b >> 2) & 0x0F));
 				} else {
-					return stretchedByte<2, 3>(b);
+					return pgm_read_byte(scale3Table() + 24 + (b >> 5));
 				}
+			case DrawingScale4:
+				return pgm_read_byte(scale4Table() + ((b >> (phase * 2)) & 0x03));
 		}
 		return b;
 	}
    
+protected:
+	
 	template<class MonochromeDisplayPageOutput>
-	static uint8_t drawPhase(
-		uint8_t phase,
-		DrawingScale scale,
+	static uint8_t drawUnscaled(
 		Data font, 
 	 	uint8_t col,
 		uint8_t page,
 		uint8_t max_width, 
 		const char *text,
-		uint8_t xor_mask
+		uint8_t xor_mask,
+		uint8_t length
 	) {
-		MonochromeDisplayPageOutput::beginWritingPage(col, page + phase);
+		MonochromeDisplayPageOutput::beginWritingPage(col, page);
 
-		char ch;
+		RangeCache cache;
+		uint16_t ch;
 		const char *src = text;
 
 		uint8_t width_left = max_width;
 		
-		uint8_t spacing_byte = scaledByte(phase, scale, xor_mask);
-
-		while ((ch = *src++)) {
+		while (width_left > 0 && src - text < length && (ch = nextCodePoint(&src))) {
 
-			uint8_t bitmap[8];
-			uint8_t width = dataForCharacter(font, ch, bitmap);
+			const uint8_t *bitmap;
+			uint8_t width = glyphOrDefault(font, ch, &bitmap, &cache);
 
-			for (uint8_t i = 0; i < width; i++) {
-				for (uint8_t j = 0; j < scale; j++) {
-					MonochromeDisplayPageOutput::writePageByte(scaledByte(phase, scale, bitmap[i] ^ xor_mask));
-					if (--width_left == 0) {
-						MonochromeDisplayPageOutput::endWritingPage();
-						return 0;
-					}
-				}
+			for (uint8_t i = 0; i < width && width_left > 0; i++, width_left--) {
+				MonochromeDisplayPageOutput::writePageByte(pgm_read_byte(bitmap + i) ^ xor_mask);
 			}
 
-			for (uint8_t j = 0; j < scale; j++) {
-				MonochromeDisplayPageOutput::writePageByte(spacing_byte);
-				if (--width_left == 0) {
-					break;
-				}
+			if (width_left > 0) {
+				MonochromeDisplayPageOutput::writePageByte(xor_mask);
+				width_left--;
 			}
 		}
 	
@@ -247,6 +524,10 @@ protected:
    
 public:
 
+	/** 
+	 * Draws as many characters of the text as fit `max_width` without clipping, centered within it. 
+	 * Returns the width of the text drawn. See TextLayout for more options.
+	 */
 	template<class MonochromeDisplayPageOutput>
 	static uint8_t drawCentered(
 		Data font, 
@@ -258,23 +539,26 @@ public:
 		const uint8_t xor_mask = 0
 	) {
 		
+		RangeCache cache;
 		uint8_t len = 0;
 		uint8_t w = 0;
 
-		char ch;
+		uint16_t ch;
 		const char *src = text;
-		while ((ch = *src++)) {
+		while ((ch = nextCodePoint(&src))) {
 			
-			uint8_t nw = w + scale * (dataForCharacter(font, ch, NULL) + 1);
+			uint16_t nw = w + scale * (dataForCodePoint(font, ch, NULL, &cache) + 1);
 			
 			if (nw > max_width)
 				break;
 			
 			w = nw;
-			len++;
+			len = src - text;
 		}
 		
-		draw<MonochromeDisplayPageOutput>(font, col + (max_width - w) / 2, page, w, text, scale, xor_mask);
+		draw<MonochromeDisplayPageOutput>(font, col + (max_width - w) / 2, page, w, text, scale, xor_mask, len);
+		
+		return w;
 	}   
 };
 
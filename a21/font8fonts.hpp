@@ -10,102 +10,173 @@
 namespace a21 {
 	
 /**
- * 8-bit font data generated from 'PixelstadTweaked'.
+ * 8-bit font data generated from 'PixelstadTweaked' via tools/a21font.py.
  */
 class Font8PixelstadTweaked {
 public:
    	static Font8::Data data() {
    		static const uint8_t PROGMEM _data[] = {
-   			// Flags: bit 0 - uppercase only
-   			1,
+   			// Flags: bit 0 - uppercase only, bit 1 - indexed format.
+   			3,
 
    			// Range ' ' to '`'.
-   			// From/to/bytes per character.
-   			32, 96, 6,
-
-   			// For each character in the range:
-   			// Actual width of the character, M;
-   			// M bytes with the pixel data of the character, one byte per column of pixels;
-   			// K zeros so M + K + 1 = bytes per characters for the range.
-   			/* ' ' */ 3, 0, 0, 0, 0, 0,
-   			/* '!' */ 1, 94, 0, 0, 0, 0,
-   			/* '"' */ 3, 6, 0, 6, 0, 0,
-   			/* '#' */ 5, 40, 124, 40, 124, 40,
-   			/* '$' */ 3, 92, 214, 116, 0, 0,
-   			/* '%' */ 3, 100, 16, 76, 0, 0,
-   			/* '&' */ 4, 52, 74, 52, 80, 0,
-   			/* ''' */ 1, 6, 0, 0, 0, 0,
-   			/* '(' */ 2, 124, 130, 0, 0, 0,
-   			/* ')' */ 2, 130, 124, 0, 0, 0,
-   			/* '*' */ 3, 20, 8, 20, 0, 0,
-   			/* '+' */ 5, 16, 16, 124, 16, 16,
-   			/* ',' */ 1, 192, 0, 0, 0, 0,
-   			/* '-' */ 4, 16, 16, 16, 16, 0,
-   			/* '.' */ 1, 64, 0, 0, 0, 0,
-   			/* '/' */ 3, 96, 16, 12, 0, 0,
-   			/* '0' */ 3, 124, 68, 124, 0, 0,
-   			/* '1' */ 3, 72, 124, 64, 0, 0,
-   			/* '2' */ 3, 116, 84, 92, 0, 0,
-   			/* '3' */ 3, 68, 84, 124, 0, 0,
-   			/* '4' */ 3, 28, 16, 124, 0, 0,
-   			/* '5' */ 3, 92, 84, 116, 0, 0,
-   			/* '6' */ 3, 124, 84, 116, 0, 0,
-   			/* '7' */ 3, 4, 116, 12, 0, 0,
-   			/* '8' */ 3, 124, 84, 124, 0, 0,
-   			/* '9' */ 3, 92, 84, 124, 0, 0,
-   			/* ':' */ 1, 72, 0, 0, 0, 0,
-   			/* ';' */ 1, 200, 0, 0, 0, 0,
-   			/* '<' */ 3, 16, 40, 68, 0, 0,
-   			/* '=' */ 4, 40, 40, 40, 40, 0,
-   			/* '>' */ 3, 68, 40, 16, 0, 0,
-   			/* '?' */ 3, 4, 82, 12, 0, 0,
-   			/* '@' */ 4, 120, 132, 180, 56, 0,
-   			/* 'A' */ 3, 120, 20, 124, 0, 0,
-   			/* 'B' */ 3, 124, 84, 40, 0, 0,
-   			/* 'C' */ 3, 56, 68, 68, 0, 0,
-   			/* 'D' */ 3, 124, 68, 56, 0, 0,
-   			/* 'E' */ 3, 124, 84, 68, 0, 0,
-   			/* 'F' */ 3, 124, 20, 4, 0, 0,
-   			/* 'G' */ 3, 124, 68, 116, 0, 0,
-   			/* 'H' */ 3, 124, 16, 124, 0, 0,
-   			/* 'I' */ 3, 68, 124, 68, 0, 0,
-   			/* 'J' */ 3, 32, 64, 60, 0, 0,
-   			/* 'K' */ 3, 124, 16, 108, 0, 0,
-   			/* 'L' */ 3, 124, 64, 64, 0, 0,
-   			/* 'M' */ 5, 124, 4, 124, 4, 120,
-   			/* 'N' */ 3, 124, 4, 120, 0, 0,
-   			/* 'O' */ 3, 124, 68, 124, 0, 0,
-   			/* 'P' */ 3, 124, 20, 28, 0, 0,
-   			/* 'Q' */ 4, 124, 68, 124, 64, 0,
-   			/* 'R' */ 3, 124, 20, 104, 0, 0,
-   			/* 'S' */ 3, 92, 84, 116, 0, 0,
-   			/* 'T' */ 3, 4, 124, 4, 0, 0,
-   			/* 'U' */ 3, 124, 64, 124, 0, 0,
-   			/* 'V' */ 3, 60, 64, 60, 0, 0,
-   			/* 'W' */ 5, 60, 64, 48, 64, 60,
-   			/* 'X' */ 3, 108, 16, 108, 0, 0,
-   			/* 'Y' */ 3, 92, 80, 124, 0, 0,
-   			/* 'Z' */ 3, 100, 84, 76, 0, 0,
-   			/* '[' */ 2, 254, 130, 0, 0, 0,
-   			/* '\' */ 3, 12, 16, 96, 0, 0,
-   			/* ']' */ 2, 130, 254, 0, 0, 0,
-   			/* '^' */ 3, 4, 2, 4, 0, 0,
-   			/* '_' */ 4, 128, 128, 128, 128, 0,
-   			/* '`' */ 2, 2, 4, 0, 0, 0,
+   			32, 96,
+   			// Offsets of the bitmaps of the characters of the range from the beginning of the font data;
+   			// the last one marks the end of the last bitmap.
+   			/* ' ' */ 148, 0,
+   			/* '!' */ 151, 0,
+   			/* '"' */ 152, 0,
+   			/* '#' */ 155, 0,
+   			/* '$' */ 160, 0,
+   			/* '%' */ 163, 0,
+   			/* '&' */ 166, 0,
+   			/* ''' */ 170, 0,
+   			/* '(' */ 171, 0,
+   			/* ')' */ 173, 0,
+   			/*  42 */ 175, 0,
+   			/* '+' */ 178, 0,
+   			/* ',' */ 183, 0,
+   			/* '-' */ 184, 0,
+   			/* '.' */ 188, 0,
+   			/*  47 */ 189, 0,
+   			/* '0' */ 192, 0,
+   			/* '1' */ 195, 0,
+   			/* '2' */ 198, 0,
+   			/* '3' */ 201, 0,
+   			/* '4' */ 204, 0,
+   			/* '5' */ 207, 0,
+   			/* '6' */ 210, 0,
+   			/* '7' */ 213, 0,
+   			/* '8' */ 216, 0,
+   			/* '9' */ 219, 0,
+   			/* ':' */ 222, 0,
+   			/* ';' */ 223, 0,
+   			/* '<' */ 224, 0,
+   			/* '=' */ 227, 0,
+   			/* '>' */ 231, 0,
+   			/* '?' */ 234, 0,
+   			/* '@' */ 237, 0,
+   			/* 'A' */ 241, 0,
+   			/* 'B' */ 244, 0,
+   			/* 'C' */ 247, 0,
+   			/* 'D' */ 250, 0,
+   			/* 'E' */ 253, 0,
+   			/* 'F' */ 0, 1,
+   			/* 'G' */ 3, 1,
+   			/* 'H' */ 6, 1,
+   			/* 'I' */ 9, 1,
+   			/* 'J' */ 12, 1,
+   			/* 'K' */ 15, 1,
+   			/* 'L' */ 18, 1,
+   			/* 'M' */ 21, 1,
+   			/* 'N' */ 26, 1,
+   			/* 'O' */ 29, 1,
+   			/* 'P' */ 32, 1,
+   			/* 'Q' */ 35, 1,
+   			/* 'R' */ 39, 1,
+   			/* 'S' */ 42, 1,
+   			/* 'T' */ 45, 1,
+   			/* 'U' */ 48, 1,
+   			/* 'V' */ 51, 1,
+   			/* 'W' */ 54, 1,
+   			/* 'X' */ 59, 1,
+   			/* 'Y' */ 62, 1,
+   			/* 'Z' */ 65, 1,
+   			/* '[' */ 68, 1,
+   			/* '\' */ 70, 1,
+   			/* ']' */ 73, 1,
+   			/* '^' */ 75, 1,
+   			/* '_' */ 78, 1,
+   			/* '`' */ 82, 1,
+   			/* end */ 84, 1,
 
    			// Range '{' to '~'.
-   			123, 126, 5,
-   			/* '{' */ 3, 16, 254, 130, 0,
-   			/* '|' */ 1, 254, 0, 0, 0,
-   			/* '}' */ 3, 130, 254, 16, 0,
-   			/* '~' */ 4, 8, 4, 8, 4,
+   			123, 126,
+   			// Offsets of the bitmaps of the characters of the range from the beginning of the font data;
+   			// the last one marks the end of the last bitmap.
+   			/* '{' */ 84, 1,
+   			/* '|' */ 87, 1,
+   			/* '}' */ 88, 1,
+   			/* '~' */ 91, 1,
+   			/* end */ 95, 1,
 
    			// End of all the ranges.
-   			0
+   			0,
+
+   			// Bitmaps, one byte per column of pixels.
+   			/* ' ' */ 0, 0, 0,
+   			/* '!' */ 94,
+   			/* '"' */ 6, 0, 6,
+   			/* '#' */ 40, 124, 40, 124, 40,
+   			/* '$' */ 92, 214, 116,
+   			/* '%' */ 100, 16, 76,
+   			/* '&' */ 52, 74, 52, 80,
+   			/* ''' */ 6,
+   			/* '(' */ 124, 130,
+   			/* ')' */ 130, 124,
+   			/*  42 */ 20, 8, 20,
+   			/* '+' */ 16, 16, 124, 16, 16,
+   			/* ',' */ 192,
+   			/* '-' */ 16, 16, 16, 16,
+   			/* '.' */ 64,
+   			/*  47 */ 96, 16, 12,
+   			/* '0' */ 124, 68, 124,
+   			/* '1' */ 72, 124, 64,
+   			/* '2' */ 116, 84, 92,
+   			/* '3' */ 68, 84, 124,
+   			/* '4' */ 28, 16, 124,
+   			/* '5' */ 92, 84, 116,
+   			/* '6' */ 124, 84, 116,
+   			/* '7' */ 4, 116, 12,
+   			/* '8' */ 124, 84, 124,
+   			/* '9' */ 92, 84, 124,
+   			/* ':' */ 72,
+   			/* ';' */ 200,
+   			/* '<' */ 16, 40, 68,
+   			/* '=' */ 40, 40, 40, 40,
+   			/* '>' */ 68, 40, 16,
+   			/* '?' */ 4, 82, 12,
+   			/* '@' */ 120, 132, 180, 56,
+   			/* 'A' */ 120, 20, 124,
+   			/* 'B' */ 124, 84, 40,
+   			/* 'C' */ 56, 68, 68,
+   			/* 'D' */ 124, 68, 56,
+   			/* 'E' */ 124, 84, 68,
+   			/* 'F' */ 124, 20, 4,
+   			/* 'G' */ 124, 68, 116,
+   			/* 'H' */ 124, 16, 124,
+   			/* 'I' */ 68, 124, 68,
+   			/* 'J' */ 32, 64, 60,
+   			/* 'K' */ 124, 16, 108,
+   			/* 'L' */ 124, 64, 64,
+   			/* 'M' */ 124, 4, 124, 4, 120,
+   			/* 'N' */ 124, 4, 120,
+   			/* 'O' */ 124, 68, 124,
+   			/* 'P' */ 124, 20, 28,
+   			/* 'Q' */ 124, 68, 124, 64,
+   			/* 'R' */ 124, 20, 104,
+   			/* 'S' */ 92, 84, 116,
+   			/* 'T' */ 4, 124, 4,
+   			/* 'U' */ 124, 64, 124,
+   			/* 'V' */ 60, 64, 60,
+   			/* 'W' */ 60, 64, 48, 64, 60,
+   			/* 'X' */ 108, 16, 108,
+   			/* 'Y' */ 92, 80, 124,
+   			/* 'Z' */ 100, 84, 76,
+   			/* '[' */ 254, 130,
+   			/* '\' */ 12, 16, 96,
+   			/* ']' */ 130, 254,
+   			/* '^' */ 4, 2, 4,
+   			/* '_' */ 128, 128, 128, 128,
+   			/* '`' */ 2, 4,
+   			/* '{' */ 16, 254, 130,
+   			/* '|' */ 254,
+   			/* '}' */ 130, 254, 16,
+   			/* '~' */ 8, 4, 8, 4,
    		};
    		return _data;
    	}
-};  
+};
 
 typedef Font8PixelstadTweaked Font8Console;
 
@@ -0,0 +1,123 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include "font8.hpp"
+
+namespace a21 {
+
+/**
+ * Support for fonts taller than 8 pixels, up to 4 pages (32 pixels), e.g. for big readouts of clocks and meters,
+ * which look better than Font8 glyphs stretched via DrawingScale.
+ *
+ * The format is the indexed format of Font8 (see tools/a21font.py) where bits 2-3 of the flags contain the number
+ * of pages of every glyph minus 1, and the bitmap of every glyph consists of that many rows of W bytes each,
+ * the topmost first. Thus the width of a glyph is the size of its bitmap divided by the number of pages,
+ * and the fonts having a single page can be used with Font8 as well.
+ */
+class FontN {
+
+public:
+
+  typedef const uint8_t *Data;
+
+  static const uint8_t MaxPages = 4;
+
+  /** The height of the font in pages of 8 pixels. */
+  static inline uint8_t pages(Data font) {
+    return ((pgm_read_byte(font) >> 2) & 3) + 1;
+  }
+
+  /** The height of the font in pixels. */
+  static inline uint8_t height(Data font) {
+    return 8 * pages(font);
+  }
+
+  /**
+   * Returns the width of the glyph corresponding to a code point and sets `bitmap` to point to its bitmap in the flash,
+   * falls back to '?' when the font has no such character. See Font8::glyphForCodePoint() regarding the `cache`.
+   */
+  static uint8_t glyphForCodePoint(Data font, uint16_t code_point, const uint8_t **bitmap, Font8::RangeCache *cache = NULL) {
+    return Font8::glyphOrDefault(font, code_point, bitmap, cache) / pages(font);
+  }
+
+  /** The width of the UTF-8 string drawn with the given font assuming 1px spacing between characters. */
+  static uint8_t textWidth(Data font, const char *text) {
+    Font8::RangeCache cache;
+    uint8_t result = 0;
+    uint16_t ch;
+    const char *src = text;
+    while ((ch = Font8::nextCodePoint(&src))) {
+      const uint8_t *bitmap;
+      result += glyphForCodePoint(font, ch, &bitmap, &cache) + 1;
+    }
+    return result;
+  }
+
+  /**
+   * Renders a text string with the given font beginning at the given column and page of a display supporting
+   * Display8 protocol, every page in a single transaction. No more than `max_width` bytes are written per page.
+   * The `xor_mask` is applied to every byte, use 0xFF to render inverted text.
+   * Returns the number of bytes written to every page.
+   */
+  template<class MonochromeDisplayPageOutput>
+  static uint8_t draw(
+    Data font,
+    uint8_t col,
+    uint8_t page,
+    uint8_t max_width,
+    const char *text,
+    uint8_t xor_mask = 0
+  ) {
+
+    uint8_t font_pages = pages(font);
+    uint8_t width_left = max_width;
+
+    for (uint8_t p = 0; p < font_pages; p++) {
+
+      MonochromeDisplayPageOutput::beginWritingPage(col, page + p);
+
+      width_left = max_width;
+      Font8::RangeCache cache;
+      uint16_t ch;
+      const char *src = text;
+      while (width_left > 0 && (ch = Font8::nextCodePoint(&src))) {
+
+        const uint8_t *bitmap;
+        uint8_t width = glyphForCodePoint(font, ch, &bitmap, &cache);
+
+        // The rows of the bitmap are stored one after another.
+        const uint8_t *row = bitmap + p * width;
+        for (uint8_t i = 0; i < width && width_left > 0; i++, width_left--) {
+          MonochromeDisplayPageOutput::writePageByte(pgm_read_byte(row + i) ^ xor_mask);
+        }
+
+        if (width_left > 0) {
+          MonochromeDisplayPageOutput::writePageByte(xor_mask);
+          width_left--;
+        }
+      }
+
+      MonochromeDisplayPageOutput::endWritingPage();
+    }
+
+    return max_width - width_left;
+  }
+
+  /**
+   * A column of a glyph with all its pages combined, the least significant bit corresponding to the topmost pixel.
+   * The `bitmap` and `width` are the ones returned by glyphForCodePoint().
+   */
+  static uint32_t column(Data font, const uint8_t *bitmap, uint8_t width, uint8_t col) {
+    uint32_t result = 0;
+    for (uint8_t p = pages(font); p > 0; p--) {
+      result = (result << 8) | pgm_read_byte(bitmap + (p - 1) * width + col);
+    }
+    return result;
+  }
+};
+
+} // namespace
@@ -7,17 +7,176 @@
 
 #include <Arduino.h>
 
+#include "font8.hpp"
+#include "fontn.hpp"
+#include "bitmatrix.hpp"
+#include "compressedbitmap.hpp"
+
+/**
+ * A compact buffer of drawing commands recorded by Framebuffer, see Framebuffer::draw(). 
+ * 
+ * Every command is stored as a 4 byte header followed by its arguments:
+ * - the command itself;
+ * - the number of bytes of arguments following the header;
+ * - the topmost and the bottommost pixel rows the command can touch, so it can be skipped when the rows are 
+ *   outside of the tile being rendered.
+ *
+ * When the buffer gets full or a command needs more than MaxArgsLength bytes of arguments (a long text), 
+ * then the list is marked as overflown and the rest of commands are not recorded.
+ * Use StaticDisplayList to have the storage allocated along with the list.
+ */
+class DisplayList {
+  
+private:
+  
+  uint8_t *_data;
+  uint16_t _capacity;
+  uint16_t _length;
+  bool _overflow;
+  
+  static inline int8_t clampRow(int16_t row) __attribute__((always_inline)) {
+    return row < -128 ? -128 : (row > 127 ? 127 : row);
+  }
+  
+public:
+  
+  static const uint8_t HeaderLength = 4;
+  
+  /** The arguments of a single command cannot be longer than this, their length is stored in a single byte. */
+  static const uint8_t MaxArgsLength = 0xFF;
+  
+  DisplayList(uint8_t *data, uint16_t capacity) 
+    : _data(data), _capacity(capacity), _length(0), _overflow(false)
+  {}
+  
+  /** Removes all the recorded commands. */
+  void clear() {
+    _length = 0;
+    _overflow = false;
+  }
+  
+  /** True if some commands could not be recorded because the buffer was too small. */
+  bool overflow() const {
+    return _overflow;
+  }
+  
+  /** Number of bytes occupied by the commands, handy to tune the capacity. */
+  uint16_t length() const {
+    return _length;
+  }
+  
+  /** Adds a new command returning a pointer to `args_length` bytes for its arguments or NULL in case of an overflow. */
+  uint8_t *append(uint8_t command, int16_t top, int16_t bottom, uint16_t args_length) {
+    
+    if (_overflow || args_length > MaxArgsLength || _length + HeaderLength + args_length > _capacity) {
+      _overflow = true;
+      return NULL;
+    }
+    
+    uint8_t *p = _data + _length;
+    p[0] = command;
+    p[1] = args_length;
+    p[2] = clampRow(top);
+    p[3] = clampRow(bottom);
+    
+    _length += HeaderLength + args_length;
+    
+    return p + HeaderLength;
+  }
+  
+  /** @{ */
+  /** Iterating through the commands. */
+  
+  const uint8_t *begin() const { return _data; }
+  const uint8_t *end() const { return _data + _length; }
+  
+  static const uint8_t *next(const uint8_t *p) { return p + HeaderLength + p[1]; }
+  
+  static uint8_t command(const uint8_t *p) { return p[0]; }
+  static int8_t top(const uint8_t *p) { return p[2]; }
+  static int8_t bottom(const uint8_t *p) { return p[3]; }
+  static const uint8_t *args(const uint8_t *p) { return p + HeaderLength; }
+  
+  /** @} */
+};
+
+/** Display list with its own storage of the given size. */
+template<uint16_t capacity>
+class StaticDisplayList : public DisplayList {
+private:
+  uint8_t _storage[capacity];
+public:
+  StaticDisplayList() : DisplayList(_storage, capacity) {}
+};
+
 /**
  * Monochrome framebuffer with layout compatible with monochrome LCDs like PCD8544 (from Nokia 3310). 
  * The `display` class should support a single static method helping to transfer the framebuffer:
  * static void writeRow(uint8_t col, uint8_t row, const uint8_t *data, uint16_t data_length)
+ * (all Display8-based displays get one for free) and should define the number of its pages in `Pages`.
+ *
+ * When the framebuffer covers the whole display, then it can be kept between frames and transferred via flush(): 
+ * every drawing routine records a range of columns it has touched in every page, so only these are sent.
+ *
+ * When the framebuffer is smaller than the display, then draw() can be used to render the picture tile by tile.
  */
 template<uint8_t _rows, uint8_t _cols, typename _display>
 class Framebuffer {
+public:
+  
+  /** Defines how the pixels being drawn are combined with the ones already in the framebuffer. */
+  enum RasterOp : uint8_t {
+    /** The pixels set in the source are set, the rest are left untouched. */
+    RasterOpOr,
+    /** The pixels set in the source are cleared, the rest are left untouched. */
+    RasterOpClear,
+    /** The pixels set in the source are inverted. */
+    RasterOpXor,
+    /** All the pixels covered by the source are replaced, i.e. its background is drawn as well. */
+    RasterOpCopy
+  };
+  
 private:
 
+  /** Drawing commands as they are recorded into display lists. */
+  enum Command : uint8_t {
+    CommandClear,
+    CommandHorizontalLine,
+    CommandVerticalLine,
+    CommandText,
+    CommandTextN,
+    CommandTextRotated,
+    CommandBlit,
+    CommandBlitRowMajor,
+    CommandBlitRotated,
+    CommandBlitCompressed
+  };
+  
   int8_t _translationY;
+  
+  /** Not NULL when drawing commands should be appended to this display list instead of being executed. */
+  DisplayList *_recording;
 
+  void recordLine(Command command, int8_t x, int8_t y, uint8_t length, uint8_t color, int16_t top, int16_t bottom) {
+    uint8_t *args = _recording->append(command, top, bottom, 4);
+    if (args) {
+      args[0] = x;
+      args[1] = y;
+      args[2] = length;
+      args[3] = color;
+    }
+  }
+  
+  void recordBlit(Command command, int8_t x, int8_t y, const uint8_t *bitmap, RasterOp op, uint8_t height) {
+    uint8_t *args = _recording->append(command, y, y + height - 1, 3 + sizeof(bitmap));
+    if (args) {
+      args[0] = x;
+      args[1] = y;
+      args[2] = op;
+      memcpy(args + 3, &bitmap, sizeof(bitmap));
+    }
+  }
+  
   inline uint8_t clamp(int8_t value, uint8_t max) __attribute__((always_inline)) {
     if (value < 0)
       return 0;
@@ -31,7 +190,92 @@ private:
   void setTranslation(int8_t rows) {
     _translationY = rows * 8;
   }  
+  
+  /** Renders a single tile beginning at the given page of the display and sends it. */
+  void drawTile(uint8_t row, void (*draw)(Framebuffer& fb), const DisplayList *list) {
+    
+    setTranslation(row);
     
+    if (list) {
+      replay(*list);
+    } else {
+      draw(*this);
+    }
+    
+    uint8_t rows = _display::Pages - row;
+    _display::writeRow(0, row, data, (rows < Rows ? rows : Rows) * Cols);
+  }
+  
+  /** Executes the commands of the list touching the current tile. */
+  void replay(const DisplayList& list) {
+    
+    int8_t top = _translationY;
+    int8_t bottom = _translationY + Height - 1;
+    
+    for (const uint8_t *p = list.begin(); p < list.end(); p = DisplayList::next(p)) {
+      
+      if (DisplayList::bottom(p) < top || DisplayList::top(p) > bottom)
+        continue;
+      
+      const uint8_t *a = DisplayList::args(p);
+      switch (DisplayList::command(p)) {
+        case CommandClear:
+          clear(a[0]);
+          break;
+        case CommandHorizontalLine:
+          drawHorizontalLine(a[0], a[1], a[2], a[3]);
+          break;
+        case CommandVerticalLine:
+          drawVerticalLine(a[0], a[1], a[2], a[3]);
+          break;
+        case CommandText:
+          {
+            a21::Font8::Data font;
+            memcpy(&font, a + 4, sizeof(font));
+            drawText(font, a[0], a[1], (const char *)(a + 4 + sizeof(font)), (a21::Font8::DrawingScale)a[2], (RasterOp)a[3]);
+          }
+          break;
+        case CommandTextN:
+          {
+            a21::FontN::Data font;
+            memcpy(&font, a + 3, sizeof(font));
+            drawTextN(font, a[0], a[1], (const char *)(a + 3 + sizeof(font)), (RasterOp)a[2]);
+          }
+          break;
+        case CommandTextRotated:
+          {
+            a21::Font8::Data font;
+            memcpy(&font, a + 3, sizeof(font));
+            drawTextRotated(font, a[0], a[1], (const char *)(a + 3 + sizeof(font)), (RasterOp)a[2]);
+          }
+          break;
+        case CommandBlit:
+        case CommandBlitRowMajor:
+        case CommandBlitRotated:
+        case CommandBlitCompressed:
+          {
+            const uint8_t *bitmap;
+            memcpy(&bitmap, a + 3, sizeof(bitmap));
+            if (DisplayList::command(p) == CommandBlit)
+              blit(a[0], a[1], bitmap, (RasterOp)a[2]);
+            else if (DisplayList::command(p) == CommandBlitRowMajor)
+              blitRowMajor(a[0], a[1], bitmap, (RasterOp)a[2]);
+            else if (DisplayList::command(p) == CommandBlitCompressed)
+              blitCompressed(a[0], a[1], bitmap, (RasterOp)a[2]);
+            else
+              blitRotated(a[0], a[1], bitmap, (RasterOp)a[2]);
+          }
+          break;
+      }
+    }
+  }
+  
+protected:
+  
+  /** The first and the last column modified in every page since the last flush. The range is empty when start > end. */
+  uint8_t _dirtyStart[_rows];
+  uint8_t _dirtyEnd[_rows];
+  
 public:
     
   static const uint8_t Cols = _cols;
@@ -39,40 +283,581 @@ public:
   static const uint8_t Width = _cols;
   static const uint8_t Height = _rows * 8;
 
-  /** The actual framebuffer can be accessed directly. */
+  /** The actual framebuffer can be accessed directly, just call markDirty() for the modified parts. */
   uint8_t data[Cols * Rows];
+  
+  Framebuffer() : _translationY(0), _recording(NULL) {
+    // We don't know what is on the display initially, so the first flush() should transfer everything.
+    markDirty();
+  }
+  
+  /** Records that the columns in the given range of the page were modified and have to be sent by the next flush(). */
+  inline void markDirty(uint8_t start_col, uint8_t end_col, uint8_t page) __attribute__((always_inline)) {
+    if (start_col < _dirtyStart[page])
+      _dirtyStart[page] = start_col;
+    if (end_col > _dirtyEnd[page])
+      _dirtyEnd[page] = end_col;
+  }
+  
+  /** Records that the whole framebuffer was modified. */
+  void markDirty() {
+    memset(_dirtyStart, 0, sizeof(_dirtyStart));
+    memset(_dirtyEnd, Cols - 1, sizeof(_dirtyEnd));
+  }
+  
+  /** Marks all the pages as not modified. */
+  void markClean() {
+    memset(_dirtyStart, 0xFF, sizeof(_dirtyStart));
+    memset(_dirtyEnd, 0, sizeof(_dirtyEnd));
+  }
+  
+  /** Returns false if the page was not modified since the last flush, otherwise returns the range of modified columns. */
+  bool dirtyColumns(uint8_t page, uint8_t& start_col, uint8_t& end_col) const {
+    start_col = _dirtyStart[page];
+    end_col = _dirtyEnd[page];
+    return start_col <= end_col;
+  }
+  
+  /** True if anything was modified since the last flush. */
+  bool isDirty() const {
+    for (uint8_t page = 0; page < Rows; page++) {
+      if (_dirtyStart[page] <= _dirtyEnd[page])
+        return true;
+    }
+    return false;
+  }
+  
+  /** 
+   * Transfers only the modified parts of the framebuffer to the display, one run of columns per page. 
+   * This is for the case the framebuffer covers the whole display and is not used with tile based draw().
+   * The `page_offset` allows to target pages of the display memory other than the visible ones, 
+   * e.g. with double buffering.
+   */
+  void flush(uint8_t page_offset = 0) {
+    for (uint8_t page = 0; page < Rows && page < _display::Pages; page++) {
+      uint8_t start = _dirtyStart[page];
+      uint8_t end = _dirtyEnd[page];
+      if (start <= end) {
+        _display::writeRow(start, page + page_offset, data + page * Cols + start, end - start + 1);
+      }
+    }
+    markClean();
+  }
+  
+  /** 
+   * Similar to flush(), but the contents of the framebuffer is rotated by 90 degrees clockwise, which allows to use 
+   * displays mounted in portrait orientation: the framebuffer should have as many columns as the display has pixel 
+   * rows and as many pixel rows as the display has columns. 
+   * Every 8x8 block is rotated via BitMatrix8, one window is sent per page of the display.
+   */
+  void flushRotated() {
+    
+    for (uint8_t display_page = 0; display_page < Cols / 8 && display_page < _display::Pages; display_page++) {
+      
+      // Pages of the framebuffer modified within the block of columns corresponding to this page of the display.
+      uint8_t block_start = display_page * 8;
+      uint8_t block_end = block_start + 7;
+      uint8_t first = 0xFF;
+      uint8_t last = 0;
+      for (uint8_t page = 0; page < Rows; page++) {
+        if (_dirtyStart[page] <= block_end && _dirtyEnd[page] >= block_start && _dirtyStart[page] <= _dirtyEnd[page]) {
+          if (first == 0xFF)
+            first = page;
+          last = page;
+        }
+      }
+      if (first == 0xFF)
+        continue;
+      
+      // The bottom pages go to the leftmost columns of the display.
+      uint8_t buffer[Height];
+      uint8_t *dst = buffer;
+      for (uint8_t page = last + 1; page > first; page--) {
+        uint8_t rotated[8];
+        a21::BitMatrix8::rotateColumnsCW(data + (page - 1) * Cols + block_start, rotated);
+        memcpy(dst, rotated, 8);
+        dst += 8;
+      }
+      
+      _display::writeRow(Height - 8 * (last + 1), display_page, buffer, dst - buffer);
+    }
+    
+    markClean();
+  }
         
   /** Tile based rendering: the given drawing routine is called multiple times to render a part of the whole picture
    * matching dimensions of the framebuffer; after drawing of each tile the framebuffer is flushed to the display. */
   void draw(void (*draw)(Framebuffer& fb)) {
-
-    uint8_t row;
-    for (row = 0; row + Rows <= _display::Rows; row += Rows) {      
-      setTranslation(row);
-      draw(*this);
-      _display::writeRow(0, row, data, sizeof(data));
+    
+    for (uint8_t row = 0; row < _display::Pages; row += Rows) {
+      drawTile(row, draw, NULL);
     }
     
-    if (row < _display::Rows) {
-      setTranslation(row);
-      draw(*this);
-      _display::writeRow(0, row, data, (_display::Rows - row) * Cols);
+    // Everything has been sent, but the contents of the framebuffer corresponds only to the last tile now.
+    setTranslation(0);
+    markClean();
+  }
+  
+  /** 
+   * Similar to the above, but the drawing routine is called only once to record its drawing commands into 
+   * the given display list, which is then replayed for every tile, skipping the commands outside of it. 
+   * This allows to use narrow tiles without running the layout code of the drawing routine for each of them. 
+   * Note that the routine should not access `data` directly in this case.
+   * If the list is too small to hold all the commands, then the drawing routine is called for every tile as usual.
+   */
+  void draw(void (*draw)(Framebuffer& fb), DisplayList& list) {
+    
+    list.clear();
+    setTranslation(0);
+    _recording = &list;
+    draw(*this);
+    _recording = NULL;
+    
+    const DisplayList *l = list.overflow() ? NULL : &list;
+    for (uint8_t row = 0; row < _display::Pages; row += Rows) {
+      drawTile(row, draw, l);
     }
+    
+    setTranslation(0);
+    markClean();
   }
   
-  void blit(int8_t x, int8_t y, const uint8_t *bitmap) {
+  /** 
+   * Draws up to 32 pixels of a single column beginning at the given point, where the least significant bit of `bits` 
+   * corresponds to the topmost pixel. Only `height` pixels are affected, which is important for RasterOpCopy.
+   * This is what most of the bitmap-based drawing is built upon.
+   */
+  void drawColumn(int8_t x, int16_t y, uint32_t bits, uint8_t height, RasterOp op = RasterOpOr) {
     
-    int8_t yy = y - _translationY;
+    if (x < 0 || x >= Width || height == 0)
+      return;
+    
+    int16_t yy = y - _translationY;
+    
+    // Clip the top and the bottom parts.
+    if (yy < 0) {
+      if (-yy >= height)
+        return;
+      bits >>= -yy;
+      height += yy;
+      yy = 0;
+    }
+    if (yy >= Height)
+      return;
+    if (yy + height > Height)
+      height = Height - yy;
+    
+    uint32_t mask = (height >= 32) ? 0xFFFFFFFF : (((uint32_t)1 << height) - 1);
+    bits &= mask;
+    
+    uint8_t page = yy >> 3;
+    uint8_t shift = yy & 7;
+    uint8_t *dst = data + page * Cols + x;
+    
+    // The first page might be touched only partially, so the bits are shifted, then they are taken 8 at a time.
+    uint8_t m = (uint8_t)(mask << shift);
+    uint8_t b = (uint8_t)(bits << shift);
+    mask >>= 8 - shift;
+    bits >>= 8 - shift;
+    
+    while (true) {
+      
+      switch (op) {
+        case RasterOpOr:
+          *dst |= b;
+          break;
+        case RasterOpClear:
+          *dst &= ~b;
+          break;
+        case RasterOpXor:
+          *dst ^= b;
+          break;
+        case RasterOpCopy:
+          *dst = (*dst & ~m) | b;
+          break;
+      }
+      markDirty(x, x, page);
+      
+      if (mask == 0)
+        break;
+      
+      page++;
+      dst += Cols;
+      m = (uint8_t)mask;
+      b = (uint8_t)bits;
+      mask >>= 8;
+      bits >>= 8;
+    }
+  }
+  
+  /** 
+   * Renders a text string with the given 8 pixel-high font, so its top left corner is at the given point. 
+   * Every glyph is read from the flash once and its columns are stretched vertically and horizontally according 
+   * to the scale. Note that RasterOpCopy fills the spacing between the characters as well.
+   * No more than `length` characters of the text are drawn.
+   * Returns the width of the text, which can extend beyond the framebuffer.
+   */
+  uint8_t drawText(
+    a21::Font8::Data font, 
+    int8_t x, 
+    int8_t y, 
+    const char *text, 
+    a21::Font8::DrawingScale scale = a21::Font8::DrawingScale1, 
+    RasterOp op = RasterOpOr,
+    uint8_t length = 0xFF
+  ) {
+    
+    const uint8_t height = 8 * scale;
+    
+    if (_recording) {
+      // Only the characters to draw are recorded, so the length is not needed in the list.
+      uint8_t text_length = strnlen(text, length);
+      uint8_t *args = _recording->append(CommandText, y, y + height - 1, 4 + sizeof(font) + text_length + 1);
+      if (args) {
+        args[0] = x;
+        args[1] = y;
+        args[2] = scale;
+        args[3] = op;
+        memcpy(args + 4, &font, sizeof(font));
+        memcpy(args + 4 + sizeof(font), text, text_length);
+        args[4 + sizeof(font) + text_length] = 0;
+      }
+      return scale * a21::Font8::textWidth(font, text, length);
+    }
+    
+    int16_t yy = y - _translationY;
+    if (yy + height <= 0 || yy >= Height) {
+      return scale * a21::Font8::textWidth(font, text, length);
+    }
+    
+    int16_t xx = x;
+    
+    a21::Font8::RangeCache cache;
+    uint16_t ch;
+    const char *src = text;
+    while (src - text < length) {
+      
+      // No need to render what is beyond the right edge, measuring the rest is cheaper.
+      if (xx >= Width) {
+        xx += scale * a21::Font8::textWidth(font, src, length - (src - text));
+        break;
+      }
+      
+      if (!(ch = a21::Font8::nextCodePoint(&src)))
+        break;
+      
+      uint8_t bitmap[8];
+      uint8_t width = a21::Font8::dataForCodePoint(font, ch, bitmap, &cache);
+      
+      for (uint8_t i = 0; i <= width; i++) {
+        
+        // The last column is the spacing between the characters.
+        uint32_t bits = (i < width) ? a21::Font8::scaledColumn(scale, bitmap[i]) : 0;
+        
+        for (uint8_t j = 0; j < scale; j++, xx++) {
+          if (xx >= 0 && xx < Width && (bits || op == RasterOpCopy)) {
+            drawColumn(xx, y, bits, height, op);
+          }
+        }
+      }
+    }
+    
+    return xx - x;
+  }
+  
+  /** 
+   * Renders a text string with the given multi-page font (see FontN), so its top left corner is at the given point. 
+   * Note that RasterOpCopy fills the spacing between the characters as well.
+   * Returns the width of the text, which can extend beyond the framebuffer.
+   */
+  uint8_t drawTextN(a21::FontN::Data font, int8_t x, int8_t y, const char *text, RasterOp op = RasterOpOr) {
+    
+    const uint8_t height = a21::FontN::height(font);
+    
+    if (_recording) {
+      uint16_t text_length = strlen(text) + 1;
+      uint8_t *args = _recording->append(CommandTextN, y, y + height - 1, 3 + sizeof(font) + text_length);
+      if (args) {
+        args[0] = x;
+        args[1] = y;
+        args[2] = op;
+        memcpy(args + 3, &font, sizeof(font));
+        memcpy(args + 3 + sizeof(font), text, text_length);
+      }
+      return a21::FontN::textWidth(font, text);
+    }
+    
+    int16_t yy = y - _translationY;
+    if (yy + height <= 0 || yy >= Height) {
+      return a21::FontN::textWidth(font, text);
+    }
+    
+    int16_t xx = x;
+    
+    a21::Font8::RangeCache cache;
+    uint16_t ch;
+    const char *src = text;
+    while (true) {
+      
+      if (xx >= Width) {
+        xx += a21::FontN::textWidth(font, src);
+        break;
+      }
+      
+      if (!(ch = a21::Font8::nextCodePoint(&src)))
+        break;
+      
+      const uint8_t *bitmap;
+      uint8_t width = a21::FontN::glyphForCodePoint(font, ch, &bitmap, &cache);
+      
+      // The last column is the spacing between the characters.
+      for (uint8_t i = 0; i <= width; i++, xx++) {
+        if (xx >= 0 && xx < Width) {
+          uint32_t bits = (i < width) ? a21::FontN::column(font, bitmap, width, i) : 0;
+          if (bits || op == RasterOpCopy) {
+            drawColumn(xx, y, bits, height, op);
+          }
+        }
+      }
+    }
+    
+    return xx - x;
+  }
+  
+  /** 
+   * Renders a text string with the given font rotated by 90 degrees clockwise, so it reads from top to bottom. 
+   * The top left corner of the first character is at the given point. The glyphs are rotated via BitMatrix8. 
+   * Returns the height of the text.
+   */
+  uint8_t drawTextRotated(a21::Font8::Data font, int8_t x, int8_t y, const char *text, RasterOp op = RasterOpOr) {
+    
+    if (_recording) {
+      uint16_t text_length = strlen(text) + 1;
+      uint8_t height = a21::Font8::textWidth(font, text);
+      uint8_t *args = _recording->append(CommandTextRotated, y, y + height - 1, 3 + sizeof(font) + text_length);
+      if (args) {
+        args[0] = x;
+        args[1] = y;
+        args[2] = op;
+        memcpy(args + 3, &font, sizeof(font));
+        memcpy(args + 3 + sizeof(font), text, text_length);
+      }
+      return height;
+    }
+    
+    int16_t yy = y;
+    
+    a21::Font8::RangeCache cache;
+    uint16_t ch;
+    const char *src = text;
+    while ((ch = a21::Font8::nextCodePoint(&src))) {
+      
+      uint8_t bitmap[8];
+      uint8_t width = a21::Font8::dataForCodePoint(font, ch, bitmap, &cache);
+      for (uint8_t i = width; i < 8; i++) {
+        bitmap[i] = 0;
+      }
+      
+      // Rows of the glyph become its columns now, the spacing is included for RasterOpCopy.
+      uint8_t rows[8];
+      a21::BitMatrix8::transpose(bitmap, rows);
+      for (uint8_t i = 0; i < 8; i++) {
+        drawColumn(x + 7 - i, yy, rows[i], (op == RasterOpCopy) ? width + 1 : width, op);
+      }
+      
+      yy += width + 1;
+    }
+    
+    return yy - y;
+  }
+  
+  /** 
+   * Draws a bitmap stored in the flash in the page layout, i.e. the same as the one of the framebuffer: 
+   * the first two bytes are its width and height in pixels, then follow (height + 7) / 8 pages of `width` bytes each.
+   */
+  void blit(int8_t x, int8_t y, const uint8_t *bitmap, RasterOp op = RasterOpOr) {
     
     const uint8_t *src = bitmap;
-    uint8_t width = *src++;
-    uint8_t height = *src++;
+    uint8_t width = pgm_read_byte(src++);
+    uint8_t height = pgm_read_byte(src++);
+    
+    if (_recording) {
+      recordBlit(CommandBlit, x, y, bitmap, op, height);
+      return;
+    }
         
+    int16_t yy = y - _translationY;
     if (x + width <= 0 || x >= Width || yy + height <= 0 || yy >= Height) {
       return;
     }
     
-    // TODO: unfinished
+    uint8_t first_col = x < 0 ? -x : 0;
+    uint8_t end_col = (x + width > Width) ? Width - x : width;
+    
+    for (uint8_t row = 0; row < height; row += 8, src += width) {
+      
+      if (yy + row + 8 <= 0 || yy + row >= Height)
+        continue;
+      
+      uint8_t h = (height - row < 8) ? height - row : 8;
+      for (uint8_t c = first_col; c < end_col; c++) {
+        drawColumn(x + c, y + row, pgm_read_byte(src + c), h, op);
+      }
+    }
+  }
+  
+  /** 
+   * Draws a compressed bitmap (see CompressedBitmap) decoding it on the fly, so no buffer is needed. 
+   * Only the parts of it overlapping the current tile are drawn, though the rest still has to be skipped.
+   */
+  void blitCompressed(int8_t x, int8_t y, const uint8_t *bitmap, RasterOp op = RasterOpOr) {
+    
+    uint8_t width = a21::CompressedBitmap::width(bitmap);
+    uint8_t height = a21::CompressedBitmap::height(bitmap);
+    
+    if (_recording) {
+      recordBlit(CommandBlitCompressed, x, y, bitmap, op, height);
+      return;
+    }
+        
+    int16_t yy = y - _translationY;
+    if (x + width <= 0 || x >= Width || yy + height <= 0 || yy >= Height) {
+      return;
+    }
+    
+    uint8_t first_col = x < 0 ? -x : 0;
+    uint8_t end_col = (x + width > Width) ? Width - x : width;
+    
+    a21::CompressedBitmap decoder(bitmap);
+    
+    for (uint8_t row = 0; row < height; row += 8) {
+      
+      if (yy + row >= Height)
+        break;
+      
+      if (yy + row + 8 <= 0) {
+        decoder.skip(width);
+        continue;
+      }
+      
+      uint8_t h = (height - row < 8) ? height - row : 8;
+      
+      decoder.skip(first_col);
+      for (uint8_t c = first_col; c < end_col; c++) {
+        drawColumn(x + c, y + row, decoder.next(), h, op);
+      }
+      decoder.skip(width - end_col);
+    }
+  }
+  
+  /** 
+   * Draws a bitmap stored in the flash in row-major format, like in PBM files: the first two bytes are its width and 
+   * height in pixels, then follow `height` rows of (width + 7) / 8 bytes each, the most significant bit of every byte 
+   * being the leftmost pixel. Every block of 8x8 pixels is converted via BitMatrix8.
+   */
+  void blitRowMajor(int8_t x, int8_t y, const uint8_t *bitmap, RasterOp op = RasterOpOr) {
+    
+    const uint8_t *src = bitmap;
+    uint8_t width = pgm_read_byte(src++);
+    uint8_t height = pgm_read_byte(src++);
+    
+    if (_recording) {
+      recordBlit(CommandBlitRowMajor, x, y, bitmap, op, height);
+      return;
+    }
+        
+    int16_t yy = y - _translationY;
+    if (x + width <= 0 || x >= Width || yy + height <= 0 || yy >= Height) {
+      return;
+    }
+    
+    uint8_t stride = (width + 7) >> 3;
+    
+    for (uint8_t row = 0; row < height; row += 8, src += 8 * stride) {
+      
+      if (yy + row + 8 <= 0 || yy + row >= Height)
+        continue;
+      
+      uint8_t h = (height - row < 8) ? height - row : 8;
+      
+      for (uint8_t block = 0; block < stride; block++) {
+        
+        int16_t bx = x + block * 8;
+        if (bx + 8 <= 0)
+          continue;
+        if (bx >= Width)
+          break;
+        
+        uint8_t rows[8];
+        for (uint8_t i = 0; i < 8; i++) {
+          rows[i] = (i < h) ? pgm_read_byte(src + i * stride + block) : 0;
+        }
+        
+        uint8_t columns[8];
+        a21::BitMatrix8::rowsToColumns(rows, columns);
+        
+        uint8_t w = (width - block * 8 < 8) ? width - block * 8 : 8;
+        for (uint8_t c = 0; c < w; c++) {
+          if (bx + c >= 0 && bx + c < Width) {
+            drawColumn(bx + c, y + row, columns[c], h, op);
+          }
+        }
+      }
+    }
+  }
+  
+  /** 
+   * Draws a bitmap in the same format as blit() but rotated by 90 degrees clockwise, so its top left corner 
+   * is at the given point and it occupies `height` columns and `width` rows. 
+   */
+  void blitRotated(int8_t x, int8_t y, const uint8_t *bitmap, RasterOp op = RasterOpOr) {
+    
+    const uint8_t *src = bitmap;
+    uint8_t width = pgm_read_byte(src++);
+    uint8_t height = pgm_read_byte(src++);
+    
+    if (_recording) {
+      recordBlit(CommandBlitRotated, x, y, bitmap, op, width);
+      return;
+    }
+    
+    int16_t yy = y - _translationY;
+    if (x + height <= 0 || x >= Width || yy + width <= 0 || yy >= Height) {
+      return;
+    }
+    
+    for (uint8_t row = 0; row < height; row += 8, src += width) {
+      
+      // Source rows become columns, so this can be clipped horizontally.
+      int16_t right = x + height - 1 - row;
+      if (right - 7 >= Width || right < 0)
+        continue;
+      
+      uint8_t h = (height - row < 8) ? height - row : 8;
+      
+      for (uint8_t col = 0; col < width; col += 8) {
+        
+        if (yy + col + 8 <= 0)
+          continue;
+        if (yy + col >= Height)
+          break;
+        
+        uint8_t w = (width - col < 8) ? width - col : 8;
+        
+        uint8_t m[8];
+        for (uint8_t i = 0; i < 8; i++) {
+          m[i] = (i < w) ? pgm_read_byte(src + col + i) : 0;
+        }
+        a21::BitMatrix8::transpose(m, m);
+        
+        for (uint8_t i = 0; i < h; i++) {
+          int16_t xx = right - i;
+          if (xx >= 0 && xx < Width) {
+            drawColumn(xx, y + col, m[i], w, op);
+          }
+        }
+      }
+    }
   }
   
   void line(int8_t x1, int8_t y1, int8_t x2, int8_t y2, uint8_t color) {
@@ -81,7 +866,17 @@ public:
   
   /** Fills the framebuffer with a specified color. */
   void clear(uint8_t color) {
+    
+    if (_recording) {
+      uint8_t *args = _recording->append(CommandClear, -128, 127, 1);
+      if (args) {
+        args[0] = color;
+      }
+      return;
+    }
+    
     memset(data, color ? 0xFF : 0x00, sizeof(data));
+    markDirty();
   }
   
   /** Draws a rectangle with the top left corner at the given point and the given size. */
@@ -102,6 +897,11 @@ public:
    * It can be made even faster by setting 8 bits at a time, but the code would become larger. */
   void drawVerticalLine(int8_t x, int8_t y, uint8_t length, uint8_t color) {
     
+    if (_recording) {
+      recordLine(CommandVerticalLine, x, y, length, color, y, y + length - 1);
+      return;
+    }
+    
     if (x < 0 || x >= Width)
       return;
     
@@ -116,6 +916,10 @@ public:
     if (yy2 > Height - 1)
       yy2 = Height - 1;
     
+    for (uint8_t page = yy1 >> 3; page <= (yy2 >> 3); page++) {
+      markDirty(x, x, page);
+    }
+    
     uint8_t *dst = data + (yy1 >> 3) * Cols + x;
     uint8_t mask = 1 << (yy1 & 7);
     
@@ -131,10 +935,14 @@ public:
       }
     } else {
       mask = ~mask;
-      for (uint8_t yy = yy1; yy <= yy2; y++) {
+      for (uint8_t yy = yy1; yy <= yy2; yy++) {
         *dst &= mask;
-        dst += Cols;
-        mask = (mask == 0x7F) ? 0xFE : (mask << 1) | 1;
+        if (mask == 0x7F) {
+          dst += Cols;
+          mask = 0xFE;
+        } else {
+          mask = (mask << 1) | 1;
+        }
       }
     }
   }
@@ -143,6 +951,11 @@ public:
    * This should be faster than a generic line drawing routine. */
   void drawHorizontalLine(int8_t x, int8_t y, uint8_t length, uint8_t color) {
     
+    if (_recording) {
+      recordLine(CommandHorizontalLine, x, y, length, color, y, y);
+      return;
+    }
+    
     int8_t yy = y - _translationY;
       
     if (yy < 0 || yy >= Height)
@@ -158,8 +971,10 @@ public:
     if (xx2 > Width - 1)
       xx2 = Width - 1;
     
+    markDirty(xx1, xx2, yy >> 3);
+    
     uint8_t *dst = data + (yy >> 3) * Cols + xx1;
-    uint8_t mask = 1 << (y & 7);
+    uint8_t mask = 1 << (yy & 7);
     
     if (color) {
       for (uint8_t xx = xx1; xx <= xx2; xx++) {
@@ -173,3 +988,187 @@ public:
     }
   }
 };
+
+/**
+ * Framebuffer keeping a copy of what the display currently shows ("shadow"), so flush() can transfer only the columns 
+ * that actually differ. This helps when every frame is redrawn from scratch and thus everything is marked dirty.
+ *
+ * The comparison is done within dirty ranges only, a machine word at a time on 32-bit MCUs. Runs of changed columns 
+ * separated by no more than `mergeGap` unchanged ones are sent as a single window, because every window costs 
+ * a few bytes of commands on the bus anyway.
+ */
+template<uint8_t _rows, uint8_t _cols, typename _display, uint8_t mergeGap = 8>
+class ShadowedFramebuffer : public Framebuffer<_rows, _cols, _display> {
+  
+private:
+  
+  typedef Framebuffer<_rows, _cols, _display> Base;
+  
+#if defined(ARDUINO_ARCH_AVR)
+  typedef uint8_t Word;
+#else
+  typedef uint32_t Word;
+#endif
+  
+  /** What the display shows, valid only when _shadowValid is true. */
+  uint8_t _shadow[_cols * _rows];
+  bool _shadowValid;
+  
+  static inline Word loadWord(const uint8_t *p) __attribute__((always_inline)) {
+    // The compiler turns this into a single load where unaligned access is allowed.
+    Word w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+  }
+  
+  /** The first column within [col, end] where the framebuffer differs from the shadow or end + 1 if there is none. */
+  static uint8_t nextChanged(const uint8_t *a, const uint8_t *b, uint8_t col, uint8_t end) {
+    
+    while (col + (uint8_t)sizeof(Word) <= end + 1 && (loadWord(a + col) ^ loadWord(b + col)) == 0) {
+      col += sizeof(Word);
+    }
+    
+    while (col <= end && (a[col] ^ b[col]) == 0) {
+      col++;
+    }
+    
+    return col;
+  }
+  
+  /** The last changed column of the run beginning at `col`, the run ends when more than mergeGap columns are equal. */
+  static uint8_t lastChanged(const uint8_t *a, const uint8_t *b, uint8_t col, uint8_t end) {
+    uint8_t last = col;
+    for (col++; col <= end && col - last <= mergeGap; col++) {
+      if (a[col] ^ b[col])
+        last = col;
+    }
+    return last;
+  }
+  
+public:
+  
+  ShadowedFramebuffer() : _shadowValid(false) {}
+  
+  /** Should be called when the contents of the display was changed bypassing this framebuffer. */
+  void invalidate() {
+    _shadowValid = false;
+    Base::markDirty();
+  }
+  
+  /** Transfers only the columns differing from what the display is showing now. */
+  void flush() {
+    
+    if (!_shadowValid) {
+      Base::flush();
+      memcpy(_shadow, Base::data, sizeof(_shadow));
+      _shadowValid = true;
+      return;
+    }
+    
+    for (uint8_t page = 0; page < _rows && page < _display::Pages; page++) {
+      
+      uint8_t start = Base::_dirtyStart[page];
+      uint8_t end = Base::_dirtyEnd[page];
+      if (start > end)
+        continue;
+      
+      uint8_t *src = Base::data + page * _cols;
+      uint8_t *shadow = _shadow + page * _cols;
+      
+      uint8_t col = nextChanged(src, shadow, start, end);
+      while (col <= end) {
+        uint8_t last = lastChanged(src, shadow, col, end);
+        uint8_t length = last - col + 1;
+        _display::writeRow(col, page, src + col, length);
+        memcpy(shadow + col, src + col, length);
+        if (last == end)
+          break;
+        col = nextChanged(src, shadow, last + 1, end);
+      }
+    }
+    
+    Base::markClean();
+  }
+};
+
+/**
+ * Double-buffered framebuffer for displays having at least twice as much memory as they show, like 128x32 SSD1306 
+ * panels with 64 rows of display memory. Every frame is uploaded into the hidden half of the memory and then 
+ * flip() makes it visible with a single setDisplayStartLine() command, so partially transferred frames are never seen.
+ *
+ * Only the columns modified in the last two frames are uploaded: the back buffer holds the frame before the previous 
+ * one, so it misses the changes of the previous frame as well as of the current one.
+ *
+ * Use flip() instead of flush() and call begin() after the display is initialized.
+ */
+template<typename _display>
+class DoubleBufferedFramebuffer : public Framebuffer<_display::Pages, _display::Cols, _display> {
+  
+private:
+  
+  typedef Framebuffer<_display::Pages, _display::Cols, _display> Base;
+  
+  static const uint8_t _rows = _display::Pages;
+  
+  static_assert(
+    _display::RamPages >= 2 * _display::Pages, 
+    "DoubleBufferedFramebuffer needs a display with at least twice as many RamPages as Pages"
+  );
+  
+  /** Dirty ranges of the previous frame, they are not yet present in the back buffer. */
+  uint8_t _prevStart[_rows];
+  uint8_t _prevEnd[_rows];
+  
+  /** 0 or 1, the half of the display memory which is not visible now. */
+  uint8_t _back;
+  
+public:
+  
+  DoubleBufferedFramebuffer() : _back(1) {
+    // Nothing is known about either half of the display memory.
+    memset(_prevStart, 0, sizeof(_prevStart));
+    memset(_prevEnd, Base::Cols - 1, sizeof(_prevEnd));
+  }
+  
+  /** Shows the first half of the display memory, so the next frame goes into the second one. */
+  void begin() {
+    _back = 1;
+    _display::setDisplayStartLine(0);
+  }
+  
+  /** Index of the half of the display memory (0 or 1) which is visible now. */
+  uint8_t front() const {
+    return _back ^ 1;
+  }
+  
+  /** Uploads the modified parts of the framebuffer into the hidden half of the display memory and then shows it. */
+  void flip() {
+    
+    uint8_t page_offset = _back * _rows;
+    
+    for (uint8_t page = 0; page < _rows; page++) {
+      
+      uint8_t start = Base::_dirtyStart[page];
+      uint8_t end = Base::_dirtyEnd[page];
+      
+      // Empty ranges have start > end, so they don't affect the union.
+      uint8_t union_start = _prevStart[page] < start ? _prevStart[page] : start;
+      uint8_t union_end = _prevEnd[page] > end ? _prevEnd[page] : end;
+      
+      // What was modified in this frame is going to be stale in the other half after the flip.
+      _prevStart[page] = start;
+      _prevEnd[page] = end;
+      
+      start = union_start;
+      end = union_end;
+      if (start <= end) {
+        _display::writeRow(start, page + page_offset, Base::data + page * Base::Cols + start, end - start + 1);
+      }
+    }
+    
+    Base::markClean();
+    
+    _display::setDisplayStartLine(_back * _display::Rows);
+    _back ^= 1;
+  }
+};
@@ -0,0 +1,204 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "clock.hpp"
+#include "framebuffer.hpp"
+
+namespace a21 {
+
+/**
+ * Shows 2^planes levels of gray on a monochrome display by frame rate modulation: every level is split into bits 
+ * kept in separate framebuffers ("planes"), which are shown in a weighted rotation. The plane holding bit N is shown 
+ * 2^N times per cycle of 2^planes - 1 frames, these are spread evenly to reduce flicker (e.g. 1, 0, 1 for 2 planes).
+ *
+ * The display should support setDisplayStartLine() and define `RamPages`, like SSD1306 does. 
+ *
+ * When all the planes fit the display memory at once (e.g. 2 planes with 128x32 SSD1306), then they are uploaded 
+ * only when modified and switching between them costs a single command. Otherwise the next plane has to be uploaded 
+ * over the visible one every frame, though only the columns differing from the plane shown before are sent.
+ *
+ * Upload budgets. SSD1306 refreshes at ~100 Hz (64 rows) or ~200 Hz (32 rows) with its default clock settings, 
+ * so there are 5-10 ms per frame. A byte takes ~23 us with I2C at 400 kHz, so a full 128x32 plane takes ~12 ms and 
+ * a 128x64 one ~23 ms: with I2C only resident planes or small differences between the planes can keep up. 
+ * With SPI at 8 MHz a full 128x64 plane takes ~1 ms, so uploading every frame works too.
+ *
+ * The display does not tell when a new frame begins, so call update() as often as possible and pass the frame period 
+ * close to the actual one to begin(). 
+ */
+template<typename display, uint8_t planes = 2, typename clock = ArduinoClock>
+class GrayscaleFramebuffer {
+  
+public:
+  
+  typedef Framebuffer<display::Pages, display::Cols, display> Plane;
+  
+  static const uint8_t Levels = 1 << planes;
+  static const uint8_t MaxLevel = Levels - 1;
+  
+  static const uint8_t Width = Plane::Width;
+  static const uint8_t Height = Plane::Height;
+  
+  /** Number of frames in a full cycle of the planes. */
+  static const uint8_t Frames = Levels - 1;
+  
+  /** True if all the planes fit the display memory at once and are not re-uploaded every frame. */
+  static const bool Resident = planes * display::Pages <= display::RamPages;
+  
+  /** Bit planes: bit N of the level of every pixel is stored in plane N. Can be drawn into directly. */
+  Plane plane[planes];
+  
+private:
+  
+  uint8_t _frame;
+  uint8_t _shown;
+  bool _shownValid;
+  uint16_t _framePeriod;
+  uint16_t _lastFrameTime;
+  
+  /** The plane to show for the frame number in the 1..Frames range. */
+  static uint8_t planeForFrame(uint8_t frame) {
+    uint8_t p = planes - 1;
+    while (!(frame & 1)) {
+      frame >>= 1;
+      p--;
+    }
+    return p;
+  }
+  
+  /** Replaces the plane being shown with the given one sending only the columns that can differ. */
+  void upload(uint8_t index) {
+    
+    Plane& next = plane[index];
+    Plane& shown = plane[_shown];
+    
+    for (uint8_t page = 0; page < display::Pages; page++) {
+      
+      uint8_t start = 0;
+      uint8_t end = Plane::Cols - 1;
+      
+      if (_shownValid) {
+        
+        // The display shows the current plane except the parts modified since it was uploaded.
+        shown.dirtyColumns(page, start, end);
+        
+        const uint8_t *a = next.data + page * Plane::Cols;
+        const uint8_t *b = shown.data + page * Plane::Cols;
+        for (uint8_t col = 0; col < Plane::Cols; col++) {
+          if (a[col] != b[col]) {
+            if (col < start)
+              start = col;
+            if (col > end)
+              end = col;
+          }
+        }
+      }
+      
+      if (start <= end) {
+        display::writeRow(start, page, next.data + page * Plane::Cols + start, end - start + 1);
+      }
+    }
+    
+    next.markClean();
+    _shown = index;
+    _shownValid = true;
+  }
+  
+public:
+  
+  GrayscaleFramebuffer() : _frame(0), _shown(0), _shownValid(false), _framePeriod(10000), _lastFrameTime(0) {}
+  
+  /** Should be called after the display is initialized. */
+  void begin(uint16_t frame_period_us = 10000) {
+    _framePeriod = frame_period_us;
+    _frame = 0;
+    _shown = 0;
+    _shownValid = false;
+    _lastFrameTime = clock::micros16();
+    if (Resident) {
+      display::setDisplayStartLine(0);
+    }
+  }
+  
+  /** 
+   * Should be called as often as possible, e.g. from loop(). Switches to the next plane when it's time to, 
+   * uploading the modified planes. Returns true if a new frame has begun.
+   */
+  bool update() {
+    
+    uint16_t now = clock::micros16();
+    if ((uint16_t)(now - _lastFrameTime) < _framePeriod)
+      return false;
+    _lastFrameTime = now;
+    
+    if (++_frame > Frames)
+      _frame = 1;
+    uint8_t next = planeForFrame(_frame);
+    
+    if (Resident) {
+      for (uint8_t i = 0; i < planes; i++) {
+        plane[i].flush(i * display::Pages);
+      }
+      if (next != _shown || !_shownValid) {
+        display::setDisplayStartLine(next * display::Rows);
+        _shown = next;
+        _shownValid = true;
+      }
+    } else {
+      upload(next);
+    }
+    
+    return true;
+  }
+  
+  /** @{ */
+  /** Drawing routines similar to the ones of Framebuffer taking the level of gray, 0 to MaxLevel, instead of color. */
+  
+  void clear(uint8_t level) {
+    for (uint8_t i = 0; i < planes; i++) {
+      plane[i].clear((level >> i) & 1);
+    }
+  }
+  
+  void drawHorizontalLine(int8_t x, int8_t y, uint8_t length, uint8_t level) {
+    for (uint8_t i = 0; i < planes; i++) {
+      plane[i].drawHorizontalLine(x, y, length, (level >> i) & 1);
+    }
+  }
+  
+  void drawVerticalLine(int8_t x, int8_t y, uint8_t length, uint8_t level) {
+    for (uint8_t i = 0; i < planes; i++) {
+      plane[i].drawVerticalLine(x, y, length, (level >> i) & 1);
+    }
+  }
+  
+  void drawRect(int8_t x, int8_t y, uint8_t width, uint8_t height, uint8_t level) {
+    for (uint8_t i = 0; i < planes; i++) {
+      plane[i].drawRect(x, y, width, height, (level >> i) & 1);
+    }
+  }
+  
+  uint8_t drawText(
+    Font8::Data font, 
+    int8_t x, 
+    int8_t y, 
+    const char *text, 
+    uint8_t level, 
+    Font8::DrawingScale scale = Font8::DrawingScale1
+  ) {
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < planes; i++) {
+      result = plane[i].drawText(font, x, y, text, scale, ((level >> i) & 1) ? Plane::RasterOpOr : Plane::RasterOpClear);
+    }
+    return result;
+  }
+  
+  /** @} */
+};
+
+} // namespace
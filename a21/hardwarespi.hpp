@@ -0,0 +1,38 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+
+namespace a21 {
+
+/** 
+ * Wrapper for the built-in SPI library having the same interface as SoftwareSPI. 
+ * This is not included by a21.hpp, so the SPI library is not pulled into every sketch.
+ */
+template<uint32_t frequency = 8000000L, uint8_t mode = SPI_MODE0>
+class HardwareSPI {
+public:
+  
+  static void begin() {
+    ::SPI.begin();
+  }
+  
+  static inline void beginTransaction() {
+    ::SPI.beginTransaction(SPISettings(frequency, MSBFIRST, mode));
+  }
+  
+  static inline void endTransaction() {
+    ::SPI.endTransaction();
+  }
+  
+  static inline void write(uint8_t b) {
+    ::SPI.transfer(b);
+  }
+};
+
+} // namespace
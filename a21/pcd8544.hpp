@@ -7,9 +7,8 @@
 
 #include <Arduino.h>
 
-#include <a21/pcd8544fonts.hpp>
+#include <a21/display8.hpp>
 #include <a21/spi.hpp>
-#include <a21/flashstring.hpp>
 
 namespace a21 {
   
@@ -17,12 +16,20 @@ namespace a21 {
  * Basic wrapper for a PCD8544 LCD display (such as the one that was used on Nokia 5110) using software SPI.
  * The parameters are FastPin-wrapped pins in the order they have on the actual device (well, at least on mine):
  * RST, CE, DC, DIN, CLK.
+ *
+ * Supports Display8 protocol, so text, bitmaps, Framebuffer and Display8Console work with it the same way 
+ * as with SSD1306, e.g.:
+ * \code
+ * typedef PCD8544< FastPin<6>, FastPin<7>, FastPin<5>, FastPin<4>, FastPin<3> > lcd;
+ * lcd::begin();
+ * lcd::drawText(Font8Console::data(), 0, 0, "Hello");
+ * \endcode
  */
 template<
    typename pinRST, typename pinCE, typename pinDC, typename pinDIN, typename pinCLK, 
    uint32_t maxFrequency = 4000000L
 >
-class PCD8544 {
+class PCD8544 : public Display8< PCD8544<pinRST, pinCE, pinDC, pinDIN, pinCLK, maxFrequency> > {
   
 public:
   
@@ -31,20 +38,52 @@ public:
     NormalVideo
   };
   
+  enum AddressingMode : uint8_t {
+    /** The column address is incremented after every data byte, then the page one; this is what Display8 uses. */
+    HorizontalAddressing = 0,
+    /** The page address is incremented after every data byte, then the column one, see writeColumns(). */
+    VerticalAddressing = 2
+  };
+  
 private:
   
   typedef SPI<pinDIN, pinCLK, pinCE, maxFrequency> spi;
   
-  enum ValueType : uint8_t {
-    Command,
-    Data
-  };
-  
-  static inline void write(ValueType valueType, uint8_t value) {
-    pinDC::write(valueType == Data);
+  /** 
+   * The DC pin is set once for a run of command or data bytes (see beginCommands() and beginData()) 
+   * instead of before every byte, so sending a byte costs only its clock cycles. 
+   */
+  static inline void write(uint8_t value) {
     spi::write(value);
   }  
 
+  /** The bytes written next are commands. */
+  static inline void beginCommands() {
+    pinDC::setLow();
+  }
+  
+  /** The bytes written next are data. */
+  static inline void beginData() {
+    pinDC::setHigh();
+  }
+  
+  /** Sends a run of data bytes. */
+  static void writeData(const uint8_t *data, uint16_t length) {
+    beginData();
+    const uint8_t *src = data;
+    for (uint16_t c = length; c > 0; c--) {
+      write(*src++);
+    }
+  }
+  
+  /** Sends the same data byte `count` times. */
+  static void fillData(uint8_t filler, uint16_t count) {
+    beginData();
+    for (uint16_t c = count; c > 0; c--) {
+      write(filler);
+    }
+  }
+
   static inline void beginWriting() {
     spi::beginWriting();
   }
@@ -98,47 +137,66 @@ private:
     SetVopMask = 0x7F
   };
 
+  /** The addressing mode the display was switched to last time, the function set command has to preserve it. */
+  static uint8_t& currentAddressingMode() {
+    static uint8_t mode = HorizontalAddressing;
+    return mode;
+  }
+  
+  /** Should be called within a run of commands, see beginCommands(). */
   static inline void extendedCommandSet(bool extended) {
     write(
-      Command, 
-      extended ? (FunctionSet | FunctionSetH) & ~(FunctionSetPD | FunctionSetV) 
-        : (FunctionSet | 0) & ~(FunctionSetPD | FunctionSetV | FunctionSetH)
+      (extended ? (FunctionSet | FunctionSetH) : FunctionSet) | currentAddressingMode()
     );
   }
   
+  /** Switches the addressing mode if needed, should be called within a run of commands. */
+  static inline void ensureAddressingModeInternal(AddressingMode mode) {
+    if (currentAddressingMode() != mode) {
+      currentAddressingMode() = mode;
+      extendedCommandSet(false);
+    }
+  }
+  
+  /** Both addresses are sent as a single run of commands, the data can follow right away, see writeData(). */
   static inline void setAddressInternal(uint8_t col, uint8_t row) {
     // Assuming that we are not in the extended command set by default.
     //~ extendedCommandSet(false);
-    write(Command, SetXAddress | col);
-    write(Command, SetYAddress | row);
+    beginCommands();
+    write(SetXAddress | col);
+    write(SetYAddress | row);
   }
   
   static inline void config(Flags flags, uint8_t operatingVoltage, uint8_t biasSystem, uint8_t temperatureControl) {
     
     beginWriting();
+    beginCommands();
         
     extendedCommandSet(true);
-    write(Command, SetVop | (operatingVoltage & SetVopMask));
-    write(Command, BiasSystem | (biasSystem & BiasSystemMask));
-    write(Command, TemperatureControl | (temperatureControl & TemperatureControlMask));
+    write(SetVop | (operatingVoltage & SetVopMask));
+    write(BiasSystem | (biasSystem & BiasSystemMask));
+    write(TemperatureControl | (temperatureControl & TemperatureControlMask));
     
     extendedCommandSet(false);
-    write(Command, DisplayControl | ((flags == InverseVideo) ? InverseVideoMode : NormalMode));
+    write(DisplayControl | ((flags == InverseVideo) ? InverseVideoMode : NormalMode));
                 
     endWriting();
   }  
     
 public:
   
-  /** Number of addressable rows, with every row corresponding to 8 horizontal lines of actual pixels. */
-  static const uint8_t Rows = 6;
+  /** Number of addressable pages (rows of the display memory), every one corresponding to 8 lines of actual pixels. */
+  static const uint8_t Pages = 6;
+  
+  /** Number of lines of pixels, see Display8. */
+  static const uint8_t Rows = 8 * Pages;
   
-  /** Number of addressable columns, though unlike rows every column corresponds to 1 vertical line of pixels. */
+  /** Number of addressable columns, though unlike pages every column corresponds to 1 vertical line of pixels. */
   static const uint8_t Cols = 84;
 
   /** For convenience the width and the height of the display in pixels. */
   static const uint8_t Width = Cols;
-  static const uint8_t Height = Rows * 8;
+  static const uint8_t Height = Rows;
   
   /** Maximum value for the parameter of operatingVoltage function, though the actual usable values are usually much smaller. */
   static const uint8_t MaxVoltage = 0x7F;
@@ -147,9 +205,10 @@ public:
   static void operatingVoltage(uint8_t value) {
     
     beginWriting();
+    beginCommands();
     
     extendedCommandSet(true);
-    write(Command, SetVop | value);
+    write(SetVop | value);
     
     // Always assuming that the normal command mode.
     extendedCommandSet(false);
@@ -157,12 +216,29 @@ public:
     endWriting();
   }
 
-  /** Clears the display. */
-  static void clear() {
+  /** 
+   * Fills a page-aligned rectangle defined by (start_col, start_page) and (end_col, end_page) points, 
+   * clears the whole display by default. All the pages are sent within a single transaction.
+   */
+  static void clear(
+    uint8_t start_col = 0, 
+    uint8_t start_page = 0, 
+    uint8_t end_col = Cols - 1, 
+    uint8_t end_page = Pages - 1, 
+    uint8_t mask = 0
+  ) {
     beginWriting();
-    setAddressInternal(0, 0);
-    for (int i = 0; i < Rows * Cols; i++) {
-      write(Data, 0);
+    beginCommands();
+    ensureAddressingModeInternal(HorizontalAddressing);
+    if (start_col == 0 && end_col == Cols - 1) {
+      // Full rows are contiguous in the display memory.
+      setAddressInternal(0, start_page);
+      fillData(mask, (end_page - start_page + 1) * Cols);
+    } else {
+      for (uint8_t page = start_page; page <= end_page; page++) {
+        setAddressInternal(start_col, page);
+        fillData(mask, end_col - start_col + 1);
+      }
     }
     endWriting();
   }
@@ -170,6 +246,8 @@ public:
   /** Initializes the display. */
   static void begin(Flags flags = NormalVideo, uint8_t operatingVoltage = 22, uint8_t biasSystem = 7, uint8_t temperatureControl = 2) {
     
+    currentAddressingMode() = HorizontalAddressing;
+    
     spi::begin();
         
     pinDC::setOutput();
@@ -186,360 +264,142 @@ public:
     clear();
   }
   
+  /** @{ */
+  /** Display8 protocol. */
+  
+  static void beginWritingPage(uint8_t col, uint8_t page) {
+    beginWriting();
+    beginCommands();
+    ensureAddressingModeInternal(HorizontalAddressing);
+    setAddressInternal(col, page);
+    beginData();
+  }
+  
+  static inline void writePageByte(uint8_t b) {
+    write(b);
+  }
+  
+  static inline void endWritingPage() {
+    endWriting();
+  }
+  
+  /** @} */
+  
   /** 
-   * Transports a bunch of bytes for the given row. The layout directly corresponds with the memory layout of the LCD, 
-   * where each byte is responsible for a 8 pixel column within the row (MSB is in the bottom of the row, 
+   * Transports a bunch of bytes for the given page. The layout directly corresponds with the memory layout of the LCD, 
+   * where each byte is responsible for a 8 pixel column within the page (MSB is in the bottom of the page, 
    * LSB is in the top).
    *
-   * The row is filled from left to right (i.e. column address is automatically incremented).
-   *                    col      col + 1
-   *  line row * 8:     # bit 0  # bit 0  ...
-   *  line row * 8 + 1: # bit 1  # bit 1  ...
+   * The page is filled from left to right (i.e. column address is automatically incremented).
+   *                     col      col + 1
+   *  line page * 8:     # bit 0  # bit 0  ...
+   *  line page * 8 + 1: # bit 1  # bit 1  ...
    *     ...
-   *  line row * 8 + 7: # bit 7  # bit 7  ...
-   *                    ^        ^
-   *                    byte 0   byte 1
+   *  line page * 8 + 7: # bit 7  # bit 7  ...
+   *                     ^        ^
+   *                     byte 0   byte 1
    *
-   * Note that if more bytes are provided than is left in the row, then they'll be written to the next one 
-   * (or the first one in case of the last row).
+   * Note that if more bytes are provided than is left in the page, then they'll be written to the next one 
+   * (or the first one in case of the last page) within the same transaction. This is what Framebuffer expects.
    */
-  static void writeRow(uint8_t col, uint8_t row, const uint8_t *data, uint16_t data_length) {
+  static void writeRow(uint8_t col, uint8_t page, const uint8_t *data, uint16_t data_length) {
     beginWriting();
-    setAddressInternal(col, row);
-    const uint8_t *src = data;
-    for (uint16_t c = data_length; c > 0; c--) {
-      write(Data, *src++);
-    }
+    beginCommands();
+    ensureAddressingModeInternal(HorizontalAddressing);
+    setAddressInternal(col, page);
+    writeData(data, data_length);
     endWriting();
   }
 
   /**
    * Similar to writeRow, but the same byte is sent `length` times.
    */
-  static void fillRow(uint8_t col, uint8_t row, uint8_t filler, uint8_t length) {
+  static void fillRow(uint8_t col, uint8_t page, uint8_t filler, uint8_t length) {
     beginWriting();
-    setAddressInternal(col, row);
-    for (uint8_t c = length; c > 0; c--) {
-      write(Data, filler);
-    }
+    beginCommands();
+    ensureAddressingModeInternal(HorizontalAddressing);
+    setAddressInternal(col, page);
+    fillData(filler, length);
     endWriting();
   }
   
-  //
-  // Support for simple 8px high fonts fitting rows of the display exactly
-  // TODO: move into its own template, can be used with other displays
-  //
-  
-  /** 
-   * Returns the width of the glyph corresponding to a character in the given font and, if a buffer is provided, 
-   * copies glyph's bitmap bytes into it. 
-   */
-  static uint8_t dataForCharacter(PCD8544Font font, char ch, uint8_t *buffer) {
- 
-    const uint8_t *p = font;
-
-    uint8_t options = pgm_read_byte(p++);
-    if ((options & 1) && 'a' <= ch && ch <= 'z') {
-      ch = ch - 'a' + 'A';
-    }
-
-    while (true) {
-
-      // First character in the range (0 would mean no more ranges are defined).
-      uint8_t first = pgm_read_byte(p++);
-      if (first == 0) 
-        break;
-
-      // Last character in the range.
-      uint8_t last = pgm_read_byte(p++);
-
-      // Number of bytes every character in the range occupies. 
-      uint8_t bytes_per_character = pgm_read_byte(p++);
-
-      if (first <= ch && ch <= last) {
-        
-        // Our character is in the range, let's copy the data for it.
-        
-        p += (ch - first) * bytes_per_character;
-        // The first byte of the glyph data is the actual width of the glyph.
-        uint8_t width = pgm_read_byte(p++);
-        // Copy the bitmap if the caller expects it.
-        if (buffer) {
-          memcpy_PF(buffer, (uint_farptr_t)p, width);
-        }
-
-        return width;
-      }
-
-      // Well, let's skip to the next range of characters.
-      p += (last + 1 - first) * bytes_per_character;      
-    }
-
-    // Let's return data for sort of a default character.
-    return dataForCharacter(font, '?', buffer);
-  }  
-
-  /** The width of the string drawn with the given font. */
-  static uint8_t textWidth(PCD8544Font font, const char *text) {
-    
-    char ch;
-    const char *src = text;
-    uint8_t result = 0;
-    while ((ch = *src++)) {      
-        uint8_t width = dataForCharacter(font, ch, NULL);
-        result += width + 1;
-    }
-    
-    return result;
-  }
-    
   /** 
-   * Renders a text string by sending the corresponding bytes directly to the LCD.
-   * The row and col parameters use LCD addressing system, where each rows occupies 8 pixels.
-   * The max_width parameter is not clipped to the actual width available.
-   * The xor_mask set to 0xFF or 0x7E can be used to render inverted text, for example.
+   * Switches the addressing mode of the display. Not needed normally as the functions writing to the display 
+   * switch to the mode they need, and only when the display is not in that mode already.
    */
-  static uint8_t drawText(
-    PCD8544Font font, 
-    const uint8_t col, 
-    const uint8_t row, 
-    const uint8_t max_width, 
-    const char *text, 
-    const uint8_t xor_mask = 0
-  ) {
-    
+  static void setAddressingMode(AddressingMode mode) {
     beginWriting();
-    
-    setAddressInternal(col, row);
-    
-    char ch;
-    const char *src = text;
-    
-    // Well, let's clip it just in case.
-    uint8_t m = Cols - col;
-    uint8_t width_left = max_width < m ? max_width : m;
-    
-    while ((ch = *src++)) {
-      
-        uint8_t bitmap[8];
-        uint8_t width = dataForCharacter(font, ch, bitmap);
-        
-        for (uint8_t i = 0; i < width; i++) {
-          write(Data, bitmap[i] ^ xor_mask);
-          if (--width_left == 0) {
-            endWriting();
-            return 0;
-          }
-        }
-        
-        write(Data, xor_mask);
-        if (--width_left == 0)
-          break;
-    }
-    
+    beginCommands();
+    currentAddressingMode() = mode;
+    extendedCommandSet(false);
     endWriting();
-    
-    return max_width - width_left;
   }
   
-  /** Returns how many characters will fit max_width pixels without clipping. */
-  static uint8_t numberOfCharsFittingWidth(PCD8544Font font, const char *text, uint8_t max_width) {
-    
-    uint8_t result = 0;
-    
-    char ch;
-    const char *src = text;
-    uint8_t total_width = 0;
-    while ((ch = *src++)) {
-      uint8_t new_total_width = total_width + dataForCharacter(font, ch, NULL) + 1;
-      if (new_total_width > max_width)
-        break;
-      total_width = new_total_width;
-      result++;
-    }
-    
-    return result;
-  }
-  
-};
-
-/**
- * Turns a PCD8544 LCD into a simple text-only display with autoscrolling.
- * Note that we don't inherit Arduino's Print class to keep the compiled code size small.
- * TODO: this was moved to Display8Console. Get rid of it here.
- */
-template<typename lcd, typename font = PCD8544FontPixelstadTweaked>
-class PCD8544Console {
-  
-private:
-  
-  static const uint8_t MaxCols = lcd::Cols / 4;
+  /** @{ */
+  /** 
+   * Column-major output: the bytes sent via writeColumnByte() fill the display top to bottom within each column
+   * beginning at the given page, continuing with the top page of the next column after the last page. 
+   * Handy for tall narrow updates (bar graphs, scrolling traces, vertical text), which would need an address per page 
+   * otherwise.
+   */
   
-  char _buffer[lcd::Rows][MaxCols + 1];
-  uint8_t _row;
-  uint8_t _col;
-  uint8_t _rowWidth;
-  uint8_t _filledRows;
-  bool _dirty;
+  static void beginWritingColumns(uint8_t col, uint8_t page = 0) {
+    beginWriting();
+    beginCommands();
+    ensureAddressingModeInternal(VerticalAddressing);
+    setAddressInternal(col, page);
+    beginData();
+  }
   
-  void lf() {
-    
-    _col = 0;
-    _rowWidth = 0;
-    
-    _row++;
-    if (_row >= lcd::Rows) {
-      _row = 0;
-    }
-    _filledRows++;
-    if (_filledRows >= lcd::Rows) {
-      _filledRows--;
-    }
-    _buffer[_row][_col] = 0;
+  static inline void writeColumnByte(uint8_t b) {
+    write(b);
   }
   
-  void cr() {
-    _col = 0;
-    _rowWidth = 0;
+  static inline void endWritingColumns() {
+    endWriting();
   }
   
-public:
+  /** @} */
   
-  PCD8544Console() 
-    : _row(0), _col(0), _rowWidth(0), _filledRows(0)
-  {}
-  
-  /** Clears the console without redrawing it on the LCD. */
-  void clear() {
-    _row = _filledRows = 0;
-    _col = 0;
-    _rowWidth = 0;
-    for (uint8_t row = 0; row < lcd::Rows; row++) {
-      _buffer[row][0] = 0;
-    }
-    _dirty = true;    
+  /** 
+   * Sends `count` full columns of Pages bytes each, the topmost byte of every column first, 
+   * beginning at the given column, in a single burst.
+   */
+  static void writeColumns(uint8_t col, const uint8_t *data, uint16_t count) {
+    beginWritingColumns(col);
+    writeData(data, count * Pages);
+    endWritingColumns();
   }
   
-  /** Transfers the contents of the console buffer to the LCD. 
-   * Note that this is not called automatically for every print() function. */
-  void draw() {
-    
-    if (!_dirty)
-      return;
+  /** 
+   * Draws a single column of pixels with a vertical segment between y0 and y1 (inclusive, in any order) set 
+   * and all other pixels cleared, in a single burst of Pages bytes. This is all a scope-style trace needs 
+   * to draw a new sample connected to the previous one (and to erase what was there before).
+   * The `xor_mask` is applied to every byte.
+   */
+  static void drawColumnSegment(uint8_t col, uint8_t y0, uint8_t y1, uint8_t xor_mask = 0) {
     
-    _dirty = false;
-        
-    for (uint8_t i = 0; i < lcd::Rows; i++) {
-      
-      int8_t row_index = _row - _filledRows + i;
-      if (row_index < 0)
-        row_index += lcd::Rows;
-      
-      // Print the row and erase the space after the last character.
-      uint8_t width = lcd::drawText(font::font(), 0, i, lcd::Cols, _buffer[row_index]);
-      lcd::fillRow(width, i, 0, lcd::Cols - width);
+    if (y0 > y1) {
+      uint8_t t = y0;
+      y0 = y1;
+      y1 = t;
     }
-  }
-
-  void print(char ch) {
-    
-    if (ch >= ' ') {
     
-      uint8_t width = lcd::dataForCharacter(font::font(), ch, NULL);
-      if (_col >= MaxCols || _rowWidth + width >= lcd::Cols) {
-        lf();        
+    beginWritingColumns(col);
+    for (uint8_t page = 0, top = 0; page < Pages; page++, top += 8) {
+      uint8_t b = 0;
+      if (y0 < top + 8 && y1 >= top) {
+        // Bits from y0 to y1 clipped to the page.
+        b = 0xFF;
+        if (y0 > top)
+          b <<= (y0 - top);
+        if (y1 < top + 7)
+          b &= 0xFF >> (top + 7 - y1);
       }
-  
-      _buffer[_row][_col] = ch;
-      _col++;
-      _buffer[_row][_col] = 0;
-      _rowWidth += width + 1;
-            
-    } else if (ch == '\n') {
-      
-      lf();
-      
-    } else if (ch == '\r') {
-      
-      cr();      
-    }
-    
-    _dirty = true;
-  }
-  
-  void print(const char *str) {
-    const char *src = str;
-    char ch;
-    while (ch = *src++) {
-      print(ch);
-    }
-  }
-  
-  void print(FlashStringPtr str) {
-    const char *src = (const char *)str;
-    char ch;
-    while (ch = pgm_read_byte(src++)) {
-      print(ch);
+      writeColumnByte(b ^ xor_mask);
     }
+    endWritingColumns();
   }
-
-  void print(int n) {
-    char buf[5 + 2];
-    itoa(n, buf, 10);
-    print(buf);
-  }
-  
-  void print(unsigned int n) {
-    char buf[5 + 1];
-    utoa(n, buf, 10);
-    print(buf);
-  }
-    
-  void print(long n) {
-    char buf[10 + 2];
-    ltoa(n, buf, 10);
-    print(buf);
-  }
-  
-  void print(unsigned long n) {
-    char buf[10 + 1];
-    ltoa(n, buf, 10);
-    print(buf);
-  }
-    
-  void println(const char *str) {
-    print(str);
-    lf();
-  }
-  
-  void println(FlashStringPtr str) {
-    print(str);
-    lf();
-  }  
-  
-  void println(int n) {
-    print(n);
-    lf();
-  }
-  
-  void println(unsigned int n) {
-    print(n);
-    lf();
-  }
-  
-  void println(long n) {
-    print(n);
-    lf();
-  }  
-  
-  void println(unsigned long n) {
-    print(n);
-    lf();
-  }  
-  
-  void println() {
-    lf();
-  }  
 };
 
 } // namespace
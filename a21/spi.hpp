@@ -32,7 +32,7 @@ private:
       #if defined(ARDUINO_ARCH_AVR)
       _delay_us(us);
       #else
-      delayMicroseconds(us);
+      ::delayMicroseconds(us);
       #endif
     }
   }
@@ -92,5 +92,28 @@ public:
     pinCE::setHigh();
   }  
 };
+
+/** 
+ * The above SPI with the interface of HardwareSPI (see hardwarespi.hpp), so either of them can be passed 
+ * to SSD1306SPI, for example. The chip select is left to the user of the class. 
+ */
+template<typename pinMOSI, typename pinSCK, unsigned long maxFrequency = 4000000>
+class SoftwareSPI : public SPI<pinMOSI, pinSCK, UnusedPin<>, maxFrequency> {
+  
+private:
+  
+  typedef SPI<pinMOSI, pinSCK, UnusedPin<>, maxFrequency> Base;
+  
+public:
+  
+  /** Brings the clock low, it's left high after the last bit of the previous transaction. */
+  static inline void beginTransaction() {
+    Base::beginWriting();
+  }
   
+  static inline void endTransaction() {
+    Base::endWriting();
+  }
+};
+
 } // namespace
@@ -7,11 +7,98 @@
 
 #include "font8.hpp"
 #include "display8.hpp"
+#include "pins.hpp"
 
 namespace a21 {
+
+/** 
+ * I2C transport for SSD1306, the default one. The `i2c` is a class like SoftwareI2C. 
+ * Every transaction begins with a control byte telling if the following bytes are commands or data.
+ */
+template<typename i2c, uint8_t slave_address>
+class SSD1306I2C {
+public:
+	
+	/** Nothing to do here, the I2C bus itself should be initialized by the user. */
+	static inline void begin() {}
+	
+	static inline bool beginCommand() {
+		return i2c::startWriting(slave_address) && i2c::write(0);
+	}
+	
+	static inline bool beginData() {
+		return i2c::startWriting(slave_address) && i2c::write(0x40);
+	}
+	
+	static inline bool write(uint8_t b) {
+		return i2c::write(b);
+	}
+	
+	static inline void end() {
+		i2c::stop();
+	}
+};
+
+/** 
+ * 4-wire SPI transport for SSD1306. The `spi` is a class like SoftwareSPI or HardwareSPI, the data/command pin 
+ * tells commands from data, and the chip select pin is optional. 
+ * Note that the write operations cannot fail here and available() is always true, so the display should be reset 
+ * via its RES pin before calling begin().
+ */
+template<typename spi, typename pinDC, typename pinCS = UnusedPin<> >
+class SSD1306SPI {
+public:
+	
+	static void begin() {
+		spi::begin();
+		pinDC::setOutput();
+		pinCS::setHigh();
+		pinCS::setOutput();
+	}
+	
+	static inline bool beginCommand() {
+		spi::beginTransaction();
+		pinDC::setLow();
+		pinCS::setLow();
+		return true;
+	}
+	
+	static inline bool beginData() {
+		spi::beginTransaction();
+		pinDC::setHigh();
+		pinCS::setLow();
+		return true;
+	}
+	
+	static inline bool write(uint8_t b) {
+		spi::write(b);
+		return true;
+	}
+	
+	static inline void end() {
+		pinCS::setHigh();
+		spi::endTransaction();
+	}
+};
+
+/** Picks the transport for the bus passed to SSD1306: anything but SSD1306SPI is assumed to be an I2C class. */
+template<typename bus, uint8_t slave_address>
+struct SSD1306Transport {
+	typedef SSD1306I2C<bus, slave_address> Type;
+};
+
+template<typename spi, typename pinDC, typename pinCS, uint8_t slave_address>
+struct SSD1306Transport<SSD1306SPI<spi, pinDC, pinCS>, slave_address> {
+	typedef SSD1306SPI<spi, pinDC, pinCS> Type;
+};
 	  
 /** 
- * Wrapper for I2C OLED displays based on SSD1306 chip.
+ * Wrapper for I2C or SPI OLED displays based on SSD1306 chip.
+ *
+ * The `bus` is either an I2C class, like SoftwareI2C (then the `slave_address` is used), or SSD1306SPI, e.g.:
+ * \code
+ * typedef SSD1306< SSD1306SPI< SoftwareSPI< FastPin<11>, FastPin<13> >, FastPin<9>, FastPin<10> > > lcd;
+ * \endcode
  * 
  * "Pages" are groups of 8 rows where each byte of the page is responsible for 8 pixels of a corresponding column. 
  * The least significant bits of every byte in the page determine the contents of the topmost 1-pixel row.
@@ -34,11 +121,15 @@ namespace a21 {
  * \endverbatim
  */
 template<
-	typename i2c, 
+	typename bus, 
 	uint8_t pages = 8,
 	uint8_t slave_address = 0x3C
 >
-class SSD1306 : public Display8< SSD1306<i2c, pages, slave_address> >{
+class SSD1306 : public Display8< SSD1306<bus, pages, slave_address> >{
+	
+private:
+	
+	typedef typename SSD1306Transport<bus, slave_address>::Type transport;
 	
 public:
 	
@@ -46,45 +137,62 @@ public:
 	static const uint8_t Rows = 8 * pages;
 	static const uint8_t Cols = 128;
 	
-	typedef SSD1306<i2c, pages, slave_address> Self;
+	/** The display memory always has 8 pages, even when only some of them are visible, like on 128x32 panels. */
+	static const uint8_t RamPages = 8;
+	
+	/** Scrolling via setDisplayStartLine() wraps around all the pages of the display memory, which are visible here 
+	 * only on 64-row panels. */
+	static const bool HardwareScroll = (RamPages == Pages);
+	
+	typedef SSD1306<bus, pages, slave_address> Self;
+
+private:
+	
+	/** The addressing mode set last or 0xFF if unknown, so we don't have to set it before every page. */
+	static uint8_t& currentAddressingMode() {
+		static uint8_t mode = 0xFF;
+		return mode;
+	}
+	
+public:
 
 	/** @{ */
 	/** Low-level command/data access. */
 
 	/** Begins a sequence of command bytes. Must be paired with endCommand(). */
 	static bool beginCommand() {
-		return i2c::startWriting(slave_address) && i2c::write(0);
+		return transport::beginCommand();
 	}
 
 	/** Begins a sequence of data bytes. Must be paired with endData(). */
 	static bool beginData() {
-		return i2c::startWriting(slave_address) && i2c::write(0x40);
+		return transport::beginData();
 	}  
 
 	/** Writes a single data or command byte depending on the current mode. */
 	static inline bool write(uint8_t a) {
-		return i2c::write(a);
+		return transport::write(a);
 	}  
 
 	/** Writes 2 data or command byte depending on the current mode. */
 	static inline bool write(uint8_t a, uint8_t b) {
-		return i2c::write(a) && i2c::write(b);
+		return transport::write(a) && transport::write(b);
 	}
 
 	/** Writes 3 data or command byte depending on the current mode. */
 	static inline bool write(uint8_t a, uint8_t b, uint8_t c) {
-		return i2c::write(a) && i2c::write(b) && i2c::write(c);
+		return transport::write(a) && transport::write(b) && transport::write(c);
 	}
 
 	/** Ends the sequence of command bytes started with beginCommand(). */
 	static inline bool endCommand() {
-		i2c::stop();
+		transport::end();
 		return true;
 	}
 
 	/** Ends the sequence of data bytes started with beginData(). */
 	static inline bool endData() {
-		i2c::stop();
+		transport::end();
 		return true;
 	}  
 
@@ -92,15 +200,15 @@ public:
 	/** Shortcuts for 1-3 byte commands, replacing beginCommand()/write(a1)..write(a3)/endCommand() sequences. */
 
 	static inline bool writeCommand(uint8_t a) {
-		return beginCommand() && i2c::write(a) && endCommand();
+		return beginCommand() && transport::write(a) && endCommand();
 	}    
 
 	static inline bool writeCommand(uint8_t a, uint8_t b) {
-		return beginCommand() && i2c::write(a) && i2c::write(b) && endCommand();
+		return beginCommand() && transport::write(a) && transport::write(b) && endCommand();
 	}    
 
 	static inline bool writeCommand(uint8_t a, uint8_t b, uint8_t c) {
-		return beginCommand() && i2c::write(a) && i2c::write(b) && i2c::write(c) && endCommand();
+		return beginCommand() && transport::write(a) && transport::write(b) && transport::write(c) && endCommand();
 	}
 	
 	/** @} */
@@ -117,10 +225,16 @@ public:
 		// and then acknowledgement bit) at I2C fast mode frequency of 400KHz.
 		const uint16_t max_tries = 1 + max_timeout_ms * 400000L / (10 * 1000);
 		
+		transport::begin();
+		
 		while (tries++ <= max_tries) {
 			if (available()) {
-				return setZoomInEnabled(true) 
-					&& setContrast(0);
+				// The display might have been reset, so don't rely on the addressing mode we've set before.
+				currentAddressingMode() = 0xFF;
+				return CommandBatch()
+					.setZoomInEnabled(true)
+					.setContrast(0)
+					.send();
 			}
 		}
 		
@@ -135,36 +249,29 @@ public:
 
 	/** Turns the display on without trying to reset it or set addressing modes, etc. */
 	static inline bool turnOn() {
-		return beginCommand() 
-			&& write(0x8D, 0x14) // "Charge Pump Settings" command with "Enable charge pump during display on".
-			&& write(0xAF) // "Set Display ON/OFF" command with X0 bit being "Display ON".
-			&& endCommand();
+		return CommandBatch().turnOn().send();
 	}
 	
 	/** Turns the display off. */
 	static inline bool turnOff() {
-		// "Set Display ON/OFF" command with X0 bit being "Display OFF".
-		return writeCommand(0xAE);
+		return CommandBatch().turnOff().send();
 	}
 
 	/** Sets the contrast. The value can be between 0x00 and 0xFF. */
 	static inline bool setContrast(uint8_t value) {
-		// "Set Contrast Control" command.
-		return writeCommand(0x81, value);
+		return CommandBatch().setContrast(value).send();
 	}
 
 	/** Allows to light up all the pixels regardless of the contents of the display's memory. 
 	* Can be used for speciall effects, like quick flashes. */
 	static inline bool setAllPixelsOn(bool enabled) {
-		// "Entire Display On" command.
-		return writeCommand(enabled ? 0xA5 : 0xA4);
+		return CommandBatch().setAllPixelsOn(enabled).send();
 	}
 
 	/** Sets inverse mode, i.e. when zero pixels are lit up and ones are not. 
 	* Can be used for convenience or special effects as well. */
 	static inline bool setInverseMode(bool enabled) {
-		// "Set Normal/Inverse Display" command.
-		return writeCommand(enabled ? 0xA7 : 0xA6);
+		return CommandBatch().setInverseMode(enabled).send();
 	}
 
 	enum FadeMode {
@@ -180,15 +287,13 @@ public:
 	/** The `interval8` parameter defines how many frames to wait between every contrast changing step 
 	* (the number of frames is `(interval8 + 1) * 8`). */
 	static inline bool setFadeMode(FadeMode mode, uint8_t interval8) {
-		// "Set Fade Out and Blinking" command.
-		return writeCommand(0x23, mode | interval8);
+		return CommandBatch().setFadeMode(mode, interval8).send();
 	}
 
 	/** Most likely you need to enable this by default on 128x32 version, because when not "zoomed in" 
 	 * the display downscales the contents of the memory vertically twice, i.e. displays every second row. */
 	static inline bool setZoomInEnabled(bool enabled) {
-		// "Set Zoom In" command.
-		return writeCommand(0xD6, enabled ? 1 : 0);
+		return CommandBatch().setZoomInEnabled(enabled).send();
 	}
 
 	/** Addressing mode defines how the data bytes received will be laid in the display's memory. */
@@ -213,9 +318,176 @@ public:
 		AddressingModePage = 2
 	};
 
+	/** 
+	 * Accumulates commands with their arguments, so they can be sent in a single transaction instead of one 
+	 * per command. This saves the start condition, the address and the control byte per command on I2C. 
+	 * The methods are named after the corresponding helpers of SSD1306 and can be chained:
+	 * \code
+	 * lcd::CommandBatch().setContrast(0xFF).setInverseMode(true).send();
+	 * \endcode
+	 */
+	class CommandBatch {
+		
+	public:
+		
+		/** The max number of command bytes in a batch. */
+		static const uint8_t Capacity = 16;
+		
+	private:
+		
+		uint8_t _data[Capacity];
+		uint8_t _length;
+		bool _overflow;
+		
+	public:
+		
+		CommandBatch() : _length(0), _overflow(false) {}
+		
+		/** @{ */
+		/** Raw 1-3 byte commands. */
+		
+		CommandBatch& add(uint8_t a) {
+			if (_length < Capacity) {
+				_data[_length++] = a;
+			} else {
+				_overflow = true;
+			}
+			return *this;
+		}
+		
+		CommandBatch& add(uint8_t a, uint8_t b) {
+			return add(a).add(b);
+		}
+		
+		CommandBatch& add(uint8_t a, uint8_t b, uint8_t c) {
+			return add(a).add(b).add(c);
+		}
+		
+		/** @} */
+		
+		/** True if the commands did not fit the batch, send() is going to fail then. */
+		bool overflow() const {
+			return _overflow;
+		}
+		
+		/** Sends all the commands in a single transaction. Returns false if this fails or the batch has overflown. */
+		bool send() {
+			
+			if (_overflow) {
+				currentAddressingMode() = 0xFF;
+				return false;
+			}
+			
+			if (_length == 0)
+				return true;
+			
+			bool result = beginCommand();
+			for (uint8_t i = 0; result && i < _length; i++) {
+				result = write(_data[i]);
+			}
+			endCommand();
+			
+			if (!result) {
+				// Not sure what the display has received, so the addressing mode has to be set again.
+				currentAddressingMode() = 0xFF;
+			}
+			
+			return result;
+		}
+		
+		CommandBatch& nop() {
+			return add(0xE3);
+		}
+		
+		CommandBatch& turnOn() {
+			// "Charge Pump Settings" command with "Enable charge pump during display on".
+			// "Set Display ON/OFF" command with X0 bit being "Display ON".
+			return add(0x8D, 0x14).add(0xAF);
+		}
+		
+		CommandBatch& turnOff() {
+			// "Set Display ON/OFF" command with X0 bit being "Display OFF".
+			return add(0xAE);
+		}
+		
+		CommandBatch& setContrast(uint8_t value) {
+			// "Set Contrast Control" command.
+			return add(0x81, value);
+		}
+		
+		CommandBatch& setAllPixelsOn(bool enabled) {
+			// "Entire Display On" command.
+			return add(enabled ? 0xA5 : 0xA4);
+		}
+		
+		CommandBatch& setInverseMode(bool enabled) {
+			// "Set Normal/Inverse Display" command.
+			return add(enabled ? 0xA7 : 0xA6);
+		}
+		
+		CommandBatch& setFadeMode(FadeMode mode, uint8_t interval8) {
+			// "Set Fade Out and Blinking" command.
+			return add(0x23, mode | interval8);
+		}
+		
+		CommandBatch& setZoomInEnabled(bool enabled) {
+			// "Set Zoom In" command.
+			return add(0xD6, enabled ? 1 : 0);
+		}
+		
+		CommandBatch& setAddressingMode(AddressingMode mode) {
+			// "Set Memory Addressing Mode".
+			currentAddressingMode() = mode;
+			return add(0x20, mode);
+		}
+		
+		/** Adds the addressing mode command only if the mode is different from the one set last. */
+		CommandBatch& ensureAddressingMode(AddressingMode mode) {
+			return currentAddressingMode() == mode ? *this : setAddressingMode(mode);
+		}
+		
+		CommandBatch& pageModeSetStartColumn(uint8_t col) {
+			// "Set Lower Column Start Address for Page Addressing Mode" 
+			// and "Set Higher Column Start Address for Page Addressing Mode" commands.
+			return add(0x00 | (col & 0x0F), 0x10 | (col >> 4));
+		}
+		
+		CommandBatch& pageModeSetPage(uint8_t page) {
+			// "Set Page Start Address for Page Addressing Mode" command.
+			return add(0xB0 | (page & 0x7));
+		}
+		
+		CommandBatch& setColumnAddresses(uint8_t start, uint8_t end) {
+			// "Set Column Address" command.
+			return add(0x21, start, end);
+		}
+		
+		CommandBatch& setPageAddresses(uint8_t start, uint8_t end) {
+			// "Set Page Address" command.
+			return add(0x22, start, end);
+		}
+		
+		CommandBatch& setWindow(uint8_t start_col, uint8_t start_page, uint8_t end_col, uint8_t end_page) {
+			return setColumnAddresses(start_col, end_col).setPageAddresses(start_page, end_page);
+		}
+		
+		CommandBatch& setDisplayStartLine(uint8_t value) {
+			return add(0x40 | (value & 0x3F));
+		}
+		
+		CommandBatch& setFlippedVertically(bool flipped) {
+			// "Set COM Output Scan Direction" and "Set Segment Re-map".
+			return add(flipped ? 0xC8 : 0xC0).add(flipped ? 0xA1 : 0xA0);
+		}
+	};
+
 	static inline bool setAddressingMode(AddressingMode mode) {
-		// "Set Memory Addressing Mode".
-		return writeCommand(0x20, mode);
+		return CommandBatch().setAddressingMode(mode).send();
+	}
+
+	/** Sets the addressing mode unless it was already set by the previous call. */
+	static inline bool ensureAddressingMode(AddressingMode mode) {
+		return CommandBatch().ensureAddressingMode(mode).send();
 	}
 
 	/** @{ */
@@ -223,15 +495,12 @@ public:
 
 	/** Sets the start column for the page addressing mode. */
 	static inline bool pageModeSetStartColumn(uint8_t col) {
-		// "Set Lower Column Start Address for Page Addressing Mode" 
-		// and "Set Higher Column Start Address for Page Addressing Mode" commands.
-		return writeCommand(0x00 | (col & 0x0F), 0x10 | (col>> 4));
+		return CommandBatch().pageModeSetStartColumn(col).send();
 	}
 	
 	/** Sets the current page in page addressing mode. */
 	static inline bool pageModeSetPage(uint8_t page) {
-		// "Set Page Start Address for Page Addressing Mode" command.
-		return writeCommand(0xB0 | page & 0x7);
+		return CommandBatch().pageModeSetPage(page).send();
 	}
 
 	/** @} */
@@ -241,14 +510,20 @@ public:
 
 	/** The columns have to be in 0-127 range, we don't mask or check them. */
 	static inline bool setColumnAddresses(uint8_t start, uint8_t end) {
-		// "Set Column Address" command.
-		return writeCommand(0x21, start, end);
+		return CommandBatch().setColumnAddresses(start, end).send();
 	}
 
 	/** The page (row) address should be between 0 and 7, we don't check or mask them here. */
 	static inline bool setPageAddresses(uint8_t start, uint8_t end) {
-		// "Set Page Address" command.
-		return writeCommand(0x22, start, end);
+		return CommandBatch().setPageAddresses(start, end).send();
+	}
+
+	/** 
+	 * Sets both the column and page addresses for the horizontal or vertical addressing modes in a single 
+	 * command transaction. 
+	 */
+	static inline bool setWindow(uint8_t start_col, uint8_t start_page, uint8_t end_col, uint8_t end_page) {
+		return CommandBatch().setWindow(start_col, start_page, end_col, end_page).send();
 	}
 
 	/** @} */
@@ -259,23 +534,27 @@ public:
  	 * The value should be in the 0-63 range. 
 	 */
 	static inline bool setDisplayStartLine(uint8_t value) {
-		return writeCommand(0x40 | value & 0x3F);
+		return CommandBatch().setDisplayStartLine(value).send();
 	}
 
 	/** Allows to flip the output vertically. 
 	 * Handy when the display is mounted upside down but we want to use the same addressing. */
 	static inline bool setFlippedVertically(bool flipped) {
-		return writeCommand(flipped ? 0xC8 : 0xC0) // "Set COM Output Scan Direction"
-			&& writeCommand(flipped ? 0xA1 : 0xA0); // "Set Segment Re-map"
+		return CommandBatch().setFlippedVertically(flipped).send();
 	} 
 
 	/** @{ */
 	/** Support for `MonochromeDisplayPageOutput`. */
 	
+	/** 
+	 * Uses the horizontal addressing mode with a window covering the rest of the page, so only one command 
+	 * transaction is needed per page (the mode itself is set once).
+	 */
 	static inline void beginWritingPage(uint8_t col, uint8_t page) {
-		setAddressingMode(AddressingModePage);
-		pageModeSetPage(page);
-		pageModeSetStartColumn(col);
+		CommandBatch()
+			.ensureAddressingMode(AddressingModeHorizontal)
+			.setWindow(col, page, Cols - 1, page)
+			.send();
 		beginData();
 	}
 	
@@ -290,7 +569,87 @@ public:
 	/** @} */
 	
 	/** @{ */
-	/** Some basic drawing routines. See Display8 template. */ 
+	/** 
+	 * Faster versions of some of the routines of Display8 sending all the pages in a single data transaction 
+	 * instead of one per page. 
+	 */
+
+	/** 
+	 * Writes `data_length` bytes beginning at the given column of the given page, wrapping to the next page when 
+	 * the end of the current one is reached. See Display8::writeRow().
+	 */
+	static void writeRow(uint8_t col, uint8_t page, const uint8_t *data, uint16_t data_length) {
+		
+		if (data_length == 0)
+			return;
+		
+		if (col != 0) {
+			// The window restarts every page at its start column, so the first page might need its own one.
+			uint8_t n = Cols - col;
+			if (n > data_length)
+				n = data_length;
+			CommandBatch()
+				.ensureAddressingMode(AddressingModeHorizontal)
+				.setWindow(col, page, Cols - 1, page)
+				.send();
+			beginData();
+			for (uint8_t i = 0; i < n; i++) {
+				write(*data++);
+			}
+			endData();
+			data_length -= n;
+			if (data_length == 0)
+				return;
+			page++;
+		}
+		
+		CommandBatch()
+			.ensureAddressingMode(AddressingModeHorizontal)
+			.setWindow(0, page, Cols - 1, page + (data_length - 1) / Cols)
+			.send();
+		beginData();
+		for (uint16_t i = 0; i < data_length; i++) {
+			write(*data++);
+		}
+		endData();
+	}
+	
+	/** 
+	 * Writes a page-aligned rectangle defined by (start_col, start_page) and (end_col, end_page) points, 
+	 * the `data` contains the bytes of every page of the rectangle, one page after another.
+	 */
+	static void writeRect(uint8_t start_col, uint8_t start_page, uint8_t end_col, uint8_t end_page, const uint8_t *data) {
+		CommandBatch()
+			.ensureAddressingMode(AddressingModeHorizontal)
+			.setWindow(start_col, start_page, end_col, end_page)
+			.send();
+		beginData();
+		uint16_t length = (uint16_t)(end_col - start_col + 1) * (end_page - start_page + 1);
+		for (uint16_t i = 0; i < length; i++) {
+			write(*data++);
+		}
+		endData();
+	}
+	
+	/** Fills a page-aligned rectangle, see Display8::clear(). */
+	static void clear(
+		uint8_t start_col = 0, 
+		uint8_t start_page = 0, 
+		uint8_t end_col = Cols - 1, 
+		uint8_t end_page = Pages - 1, 
+		uint8_t mask = 0
+	) {
+		CommandBatch()
+			.ensureAddressingMode(AddressingModeHorizontal)
+			.setWindow(start_col, start_page, end_col, end_page)
+			.send();
+		beginData();
+		uint16_t length = (uint16_t)(end_col - start_col + 1) * (end_page - start_page + 1);
+		for (uint16_t i = 0; i < length; i++) {
+			write(mask);
+		}
+		endData();
+	}
  
 	/** @} */
 };
@@ -0,0 +1,295 @@
+//
+// a21 — Arduino Toolkit.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#pragma once
+
+#include "font8.hpp"
+
+namespace a21 {
+
+/**
+ * Breaks a text into lines fitting the given width in a single pass over it, measuring every character once.
+ * Lines are wrapped at spaces or anywhere within words too long for a line, as well as at '\n' characters.
+ * When the text does not fit `maxLines` lines, then the last line is cut and followed by an ellipsis ("...").
+ *
+ * The result is a small array of lines (offset and length within the text and the width in pixels), which can be
+ * drawn via Display8 or into a Framebuffer without measuring the text again, aligned as needed, e.g.:
+ * \code
+ * TextLayout<2> layout;
+ * layout.layout(Font8Console::data(), "Press the button to continue", 64);
+ * layout.draw<lcd>(32, 2, 64, TextLayout<2>::AlignCenter);
+ * \endcode
+ *
+ * The text is UTF-8, it should stay in memory while the layout is used and be shorter than 256 bytes.
+ */
+template<uint8_t maxLines = 4>
+class TextLayout {
+
+public:
+
+  enum Options : uint8_t {
+    /** Wrap lines longer than the width, otherwise they are cut and can end with an ellipsis. */
+    OptionWrap = 1,
+    /** Cut lines end with an ellipsis. */
+    OptionEllipsis = 2,
+    OptionsDefault = OptionWrap | OptionEllipsis
+  };
+
+  enum Align : uint8_t {
+    AlignLeft,
+    AlignCenter,
+    AlignRight
+  };
+
+  struct Line {
+    /** The offset of the first character of the line within the text. */
+    uint8_t start;
+    /** The number of bytes of the text to draw. */
+    uint8_t length;
+    /** The width of the line in pixels including the ellipsis, if any. */
+    uint8_t width;
+    /** True if the line should be followed by an ellipsis. */
+    bool ellipsis;
+  };
+
+private:
+
+  Font8::Data _font;
+  const char *_text;
+  Font8::DrawingScale _scale;
+  uint8_t _count;
+  Line _lines[maxLines];
+
+  void addLine(uint8_t start, uint8_t length, uint8_t width, bool ellipsis) {
+    Line& line = _lines[_count++];
+    line.start = start;
+    line.length = length;
+    line.width = width;
+    line.ellipsis = ellipsis;
+  }
+
+  static uint8_t alignedOffset(uint8_t line_width, uint8_t width, Align align) {
+    if (line_width >= width || align == AlignLeft)
+      return 0;
+    else if (align == AlignCenter)
+      return (width - line_width) / 2;
+    else
+      return width - line_width;
+  }
+
+public:
+
+  TextLayout() : _font(NULL), _text(NULL), _scale(Font8::DrawingScale1), _count(0) {}
+
+  void layout(
+    Font8::Data font,
+    const char *text,
+    uint8_t max_width,
+    Font8::DrawingScale scale = Font8::DrawingScale1,
+    uint8_t options = OptionsDefault
+  ) {
+
+    _font = font;
+    _text = text;
+    _scale = scale;
+    _count = 0;
+
+    Font8::RangeCache cache;
+    
+    // The dot is the only character measured more than once.
+    uint16_t ellipsis_width = (options & OptionEllipsis) ? 3 * scale * (Font8::dataForCharacter(font, '.', NULL) + 1) : 0;
+
+    uint8_t line_start = 0;
+    uint16_t line_width = 0;
+
+    // The last run of spaces within the line: where it begins (0xFF if none) and ends, 
+    // the width of the line before it and including it.
+    uint8_t break_pos = 0xFF;
+    uint8_t break_end = 0;
+    uint16_t break_width = 0;
+    uint16_t after_break_width = 0;
+
+    // The longest beginning of the line which can be followed by the ellipsis.
+    uint8_t fit_length = 0;
+    uint16_t fit_width = 0;
+
+    uint8_t i = 0;
+    while (true) {
+
+      const char *src = text + i;
+      uint16_t ch = Font8::nextCodePoint(&src);
+      uint8_t next = src - text;
+      bool last_line = (_count == maxLines - 1);
+
+      // Handling the cases when the current line cannot be continued.
+      bool end_of_line = (ch == 0 || ch == '\n');
+      uint16_t w = 0;
+      bool overflow = false;
+      if (!end_of_line) {
+        w = scale * (Font8::dataForCodePoint(font, ch, NULL, &cache) + 1);
+        overflow = (line_width + w > max_width && i > line_start);
+      }
+
+      if (end_of_line && !(ch == '\n' && last_line && text[i + 1] != 0)) {
+
+        addLine(line_start, i - line_start, line_width, false);
+        if (ch == 0 || last_line)
+          return;
+
+      } else if (end_of_line || (overflow && (last_line || !(options & OptionWrap)))) {
+
+        // Cutting the line here.
+        if (options & OptionEllipsis) {
+          addLine(line_start, fit_length, fit_width + ellipsis_width, true);
+        } else {
+          addLine(line_start, i - line_start, line_width, false);
+        }
+        if (last_line)
+          return;
+
+        // Skipping the rest of the line.
+        while (text[i] != 0 && text[i] != '\n')
+          i++;
+        if (text[i] == 0)
+          return;
+
+      } else if (overflow) {
+
+        if (ch == ' ') {
+          // Wrapping right here, the spaces the line ends with are not needed, neither are the ones following them.
+          if (break_pos != 0xFF && break_end == i) {
+            addLine(line_start, break_pos - line_start, break_width, false);
+          } else {
+            addLine(line_start, i - line_start, line_width, false);
+          }
+          while (text[i] == ' ')
+            i++;
+          // The wrap and a line break or the end of the text coinciding should not give an empty line.
+          if (text[i] == 0)
+            return;
+          if (text[i] == '\n')
+            i++;
+          line_start = i;
+          line_width = 0;
+        } else if (break_pos != 0xFF) {
+          // Wrapping at the last run of spaces, the characters after it begin the next line.
+          addLine(line_start, break_pos - line_start, break_width, false);
+          line_start = break_end;
+          line_width -= after_break_width;
+        } else {
+          addLine(line_start, i - line_start, line_width, false);
+          line_start = i;
+          line_width = 0;
+        }
+
+        break_pos = 0xFF;
+        if (line_width + ellipsis_width <= max_width) {
+          fit_length = i - line_start;
+          fit_width = line_width;
+        } else {
+          fit_length = 0;
+          fit_width = 0;
+        }
+
+        // The current character is going to be checked again with the new line.
+        continue;
+
+      } else {
+
+        if (ch == ' ') {
+          // Continuing the run of spaces when the previous character was a space as well.
+          if (break_pos == 0xFF || break_end != i) {
+            break_pos = i;
+            break_width = line_width;
+          }
+          break_end = next;
+          after_break_width = line_width + w;
+        }
+
+        line_width += w;
+        if (line_width + ellipsis_width <= max_width) {
+          fit_length = next - line_start;
+          fit_width = line_width;
+        }
+
+        i = next;
+        continue;
+      }
+
+      // Beginning the next line after '\n'.
+      i++;
+      line_start = i;
+      line_width = 0;
+      break_pos = 0xFF;
+      fit_length = 0;
+      fit_width = 0;
+    }
+  }
+
+  uint8_t lineCount() const {
+    return _count;
+  }
+
+  const Line& line(uint8_t index) const {
+    return _lines[index];
+  }
+
+  /** The width of the widest line. */
+  uint8_t width() const {
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_lines[i].width > result)
+        result = _lines[i].width;
+    }
+    return result;
+  }
+
+  /** The height of all the lines in pixels. */
+  uint8_t height() const {
+    return _count * 8 * _scale;
+  }
+
+  /**
+   * Draws the lines directly to a display supporting Display8 protocol, the first one at the given page,
+   * aligned within `width` columns beginning at `col`.
+   */
+  template<class display>
+  void draw(uint8_t col, uint8_t page, uint8_t width, Align align = AlignLeft, uint8_t xor_mask = 0) const {
+    for (uint8_t i = 0; i < _count; i++) {
+      const Line& line = _lines[i];
+      uint8_t x = col + alignedOffset(line.width, width, align);
+      uint8_t p = page + i * _scale;
+      if (x >= display::Cols || p >= display::Pages)
+        break;
+      uint8_t w = Font8::draw<display>(_font, x, p, display::Cols - x, _text + line.start, _scale, xor_mask, line.length);
+      if (line.ellipsis && x + w < display::Cols) {
+        Font8::draw<display>(_font, x + w, p, display::Cols - x - w, "...", _scale, xor_mask);
+      }
+    }
+  }
+
+  /** Draws the lines into a Framebuffer, the top of the first one at the given point, aligned within `width` pixels. */
+  template<class framebuffer>
+  void draw(
+    framebuffer& fb,
+    int8_t x,
+    int8_t y,
+    uint8_t width,
+    Align align = AlignLeft,
+    typename framebuffer::RasterOp op = framebuffer::RasterOpOr
+  ) const {
+    for (uint8_t i = 0; i < _count; i++) {
+      const Line& line = _lines[i];
+      int8_t xx = x + alignedOffset(line.width, width, align);
+      int8_t yy = y + i * 8 * _scale;
+      uint8_t w = fb.drawText(_font, xx, yy, _text + line.start, _scale, op, line.length);
+      if (line.ellipsis) {
+        fb.drawText(_font, xx + w, yy, "...", _scale, op);
+      }
+    }
+  }
+};
+
+} // namespace
@@ -14,47 +14,62 @@ DHT22< FastPin<2>, false > dht22;
 // Here we are showing sensor readings on a Nokia display, though anything else would work of course.
 // The pins are in the order of the display: RST, CE, DC, DIN, CLK. 
 // I am not using RST and CE here, so it can easily work with Digispark.
-typedef PCD8544< UnusedPin, UnusedPin, FastPin<5>, FastPin<4>, FastPin<0> > LCD;
-LCD lcd;
+typedef PCD8544< UnusedPin<>, UnusedPin<>, FastPin<5>, FastPin<4>, FastPin<0> > lcd;
 
-// A simple text console that is able to render itself to the LCD.
-PCD8544Console<LCD, PCD8544FontPixelstadTweaked> console;
+// A simple text console that is able to render itself to the LCD, the same as used with other Display8 displays.
+typedef Display8Console<lcd, Font8Console> console;
+
+// Where the values go: the rows of the console and the characters right after the labels.
+const uint8_t TemperatureRow = 2;
+const uint8_t HumidityRow = 3;
+const uint8_t ErrorRow = 4;
+const uint8_t ValueCol = 13;
 
 void setup() {
   
-  lcd.begin();  
+  lcd::begin();  
+  
+  // The labels are printed only once, the loop is updating the values after them.
+  console::println(F("a21 - DHT22 example"));
+  console::println();
+  console::println(F("Temperature:"));
+  console::print(F("Humidity:"));
   
-  // The console is clean initially, so drawing it effectively clears the display.
-  console.draw();
+  // The console does not know what is on the display initially, so the first draw clears it fully.
+  console::draw();
 }
 
 void loop() {
-    
-  console.clear();
-  console.println(F("a21 - DHT22 example"));
-  console.println();
-
+  
   // Both values will be premultiplied by 10. I don't divide them by 10 in the DHT22 to avoid using floating point. 
   // Also, some monitoring applications can always work with premultiplied values.
   int16_t temperature;
   uint16_t humidity;
   if (dht22.read(temperature, humidity)) {
     
-    console.print(F("Temperature: "));
-    console.print(temperature / 10);
-    console.println(F("C"));
+    // Printing over the previous value and removing what is left of it, e.g. when "100%" becomes "99%".
+    // Only the rows that have actually changed are going to be sent to the display.
+    console::setCursor(TemperatureRow, ValueCol);
+    console::print(temperature / 10);
+    console::print(F("C"));
+    console::clearToEndOfLine();
+    
+    console::setCursor(HumidityRow, ValueCol);
+    console::print(humidity / 10);
+    console::print(F("%"));
+    console::clearToEndOfLine();
     
-    console.print(F("Humidity: "));
-    console.print(humidity / 10);
-    console.println(F("%"));
+    console::setCursor(ErrorRow, 0);
+    console::clearToEndOfLine();
     
   } else {
     
-    console.print(F("Cannot read DHT22"));
+    // The last known values are kept on the screen.
+    console::setCursor(ErrorRow, 0);
+    console::print(F("Cannot read DHT22"));
   }
 
-  console.draw();
+  console::draw();
 
   delay(1000);
 }
-
@@ -0,0 +1,145 @@
+//
+// a21 — Arduino Toolkit. Benchmark for Framebuffer::flush() strategies.
+// Copyright (C) 2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+#include <a21.hpp>
+
+using namespace a21;
+
+//
+// No display is needed here: we render a simple dashboard-like UI into a virtual 128x32 display, which only counts 
+// the bytes it receives, and compare the traffic of 3 strategies:
+// - uploading of the full frame every time;
+// - uploading of dirty column ranges only (Framebuffer::flush());
+// - uploading of the columns that differ from the shadow copy (ShadowedFramebuffer::flush()).
+// Every frame is redrawn from scratch, which is the worst case for the dirty ranges.
+//
+
+class CountingDisplay : public Display8<CountingDisplay> {
+public:
+  
+  static const uint8_t Pages = 4;
+  static const uint8_t Rows = 8 * Pages;
+  static const uint8_t Cols = 128;
+  
+  static uint32_t bytes;
+  static uint32_t windows;
+
+  static void beginWritingPage(uint8_t col, uint8_t page) { windows++; }
+  static void writePageByte(uint8_t b) { bytes++; }
+  static void endWritingPage() {}
+  
+  static void reset() {
+    bytes = 0;
+    windows = 0;
+  }
+};
+
+uint32_t CountingDisplay::bytes;
+uint32_t CountingDisplay::windows;
+
+typedef Framebuffer<CountingDisplay::Pages, CountingDisplay::Cols, CountingDisplay> FB;
+typedef ShadowedFramebuffer<CountingDisplay::Pages, CountingDisplay::Cols, CountingDisplay> ShadowedFB;
+
+// The shadowed framebuffer takes twice as much RAM, so the two are not kept around at the same time.
+union {
+  FB *plain;
+  ShadowedFB *shadowed;
+} fb;
+
+template<typename T>
+void drawSegmentDigit(T& fb, int8_t x, int8_t y, uint8_t digit) {
+  
+  // Segments A-G of a 7-segment indicator, 6x11 pixels.
+  static const uint8_t segments[] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+  uint8_t s = segments[digit];
+  
+  if (s & 0x01) fb.drawHorizontalLine(x, y, 6, 1);
+  if (s & 0x02) fb.drawVerticalLine(x + 5, y, 6, 1);
+  if (s & 0x04) fb.drawVerticalLine(x + 5, y + 5, 6, 1);
+  if (s & 0x08) fb.drawHorizontalLine(x, y + 10, 6, 1);
+  if (s & 0x10) fb.drawVerticalLine(x, y + 5, 6, 1);
+  if (s & 0x20) fb.drawVerticalLine(x, y, 6, 1);
+  if (s & 0x40) fb.drawHorizontalLine(x, y + 5, 6, 1);
+}
+
+template<typename T>
+void drawFrame(T& fb, uint16_t t) {
+  
+  fb.clear(0);
+  
+  // Static parts: a title bar and a frame.
+  for (uint8_t y = 0; y < 7; y++) {
+    fb.drawHorizontalLine(0, y, T::Width, 1);
+  }
+  fb.drawRect(0, 0, T::Width, T::Height, 1);
+  
+  // A clock ticking once per frame.
+  uint16_t seconds = 12 * 3600L + 34 * 60 + t;
+  uint8_t digits[] = {
+    (uint8_t)(seconds / 36000 % 10), (uint8_t)(seconds / 3600 % 10),
+    (uint8_t)(seconds % 3600 / 600), (uint8_t)(seconds % 3600 / 60 % 10),
+    (uint8_t)(seconds % 60 / 10), (uint8_t)(seconds % 10)
+  };
+  for (uint8_t i = 0; i < sizeof(digits); i++) {
+    drawSegmentDigit(fb, 30 + i * 9 + (i / 2) * 4, 10, digits[i]);
+  }
+  
+  // A progress bar growing by a pixel every frame.
+  fb.drawRect(4, 24, 120, 5, 1);
+  for (uint8_t y = 25; y < 28; y++) {
+    fb.drawHorizontalLine(5, y, t % 118, 1);
+  }
+}
+
+const uint16_t Frames = 100;
+
+void report(const __FlashStringHelper *title) {
+  Serial.print(title);
+  Serial.print(F(": "));
+  Serial.print(CountingDisplay::bytes);
+  Serial.print(F(" bytes in "));
+  Serial.print(CountingDisplay::windows);
+  Serial.print(F(" windows, "));
+  Serial.print(CountingDisplay::bytes / Frames);
+  Serial.println(F(" bytes per frame"));
+}
+
+void setup() {
+  
+  Serial.begin(115200);
+  Serial.println(F("a21 - Framebuffer flush() benchmark"));
+
+  fb.plain = new FB();
+  
+  CountingDisplay::reset();
+  for (uint16_t t = 0; t < Frames; t++) {
+    drawFrame(*fb.plain, t);
+    fb.plain->markDirty();
+    fb.plain->flush();
+  }
+  report(F("Full upload"));
+  
+  CountingDisplay::reset();
+  for (uint16_t t = 0; t < Frames; t++) {
+    drawFrame(*fb.plain, t);
+    fb.plain->flush();
+  }
+  report(F("Dirty ranges"));
+  
+  delete fb.plain;
+  fb.shadowed = new ShadowedFB();
+  
+  CountingDisplay::reset();
+  for (uint16_t t = 0; t < Frames; t++) {
+    drawFrame(*fb.shadowed, t);
+    fb.shadowed->flush();
+  }
+  report(F("Shadow diff"));
+  
+  delete fb.shadowed;
+}
+
+void loop() {
+}
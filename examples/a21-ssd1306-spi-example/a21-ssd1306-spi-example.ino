@@ -0,0 +1,36 @@
+//
+// a21 — Arduino Toolkit. Example for SSD1306 connected via hardware SPI.
+// Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+//
+
+// Both a21.hpp (with a21::SPI, the software one used by PCD8544) and hardwarespi.hpp (wrapping the SPI object 
+// of the built-in library) are included here on purpose, so it's easy to see that they can be used together.
+#include <a21.hpp>
+#include <a21/hardwarespi.hpp>
+
+using namespace a21;
+
+// MOSI and SCK are the hardware SPI pins (11 and 13 on Uno), DC is on pin 9, CS is on pin 10.
+typedef SSD1306< SSD1306SPI< HardwareSPI<>, FastPin<9>, FastPin<10> > > lcd;
+
+void setup() {
+  
+  lcd::begin();
+  lcd::clear();
+  lcd::turnOn();
+  
+  lcd::drawText(Font8Console::data(), 0, 0, "a21 - SSD1306 SPI");
+}
+
+void loop() {
+  
+  static uint16_t counter = 0;
+  
+  char buf[5 + 1];
+  utoa(counter++, buf, 10);
+  
+  lcd::clear(0, 2, lcd::Cols - 1, 3);
+  lcd::drawText(Font8Console::data(), 0, 2, buf, Font8::DrawingScale2);
+  
+  delay(100);
+}
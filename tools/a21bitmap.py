@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+#
+# a21 — Arduino Toolkit.
+# Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+#
+
+"""
+Converts PBM/PGM/PNG images into monochrome bitmaps for a21, emitting a C array to be stored in the flash.
+
+Formats (see --format):
+- compressed: for Framebuffer::blitCompressed() and Display8::drawCompressedBitmap(), see CompressedBitmap;
+- pages: raw page layout for Framebuffer::blit();
+- rowmajor: raw row-major layout for Framebuffer::blitRowMajor().
+
+Dark pixels are lit by default, which suits artwork drawn on white background; use --invert for photos. 
+Use --dither bayer to represent shades of gray via ordered dithering, the same as Dither class does on the MCU.
+
+Example:
+    tools/a21bitmap.py splash.png --name splash > splash.h
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+
+class Image:
+    """Grayscale image, 0 is black, 255 is white."""
+
+    def __init__(self, width, height, pixels):
+        self.width = width
+        self.height = height
+        self.pixels = pixels
+
+    def gray(self, x, y):
+        return self.pixels[y * self.width + x]
+
+
+def _netpbm_tokens(data):
+    """Header tokens of a Netpbm file and the offset of the binary data following them."""
+    tokens = []
+    pos = 0
+    while len(tokens) < 4:
+        m = re.compile(rb"\s*(#[^\n]*\n\s*)*(\S+)").match(data, pos)
+        if not m:
+            raise ValueError("truncated header")
+        tokens.append(m.group(2))
+        pos = m.end()
+        if tokens[0] in (b"P1", b"P4") and len(tokens) == 3:
+            break
+    # Exactly one whitespace character separates the header from the binary data.
+    return tokens, pos + 1
+
+
+def read_netpbm(data):
+    tokens, offset = _netpbm_tokens(data)
+    magic = tokens[0]
+    width, height = int(tokens[1]), int(tokens[2])
+    if magic == b"P1":
+        bits = re.sub(rb"#[^\n]*\n|\s", b"", data[offset - 1:])
+        return Image(width, height, [0 if b == ord("1") else 255 for b in bits[:width * height]])
+    if magic == b"P4":
+        stride = (width + 7) // 8
+        pixels = []
+        for y in range(height):
+            row = data[offset + y * stride:offset + (y + 1) * stride]
+            pixels += [0 if row[x >> 3] & (0x80 >> (x & 7)) else 255 for x in range(width)]
+        return Image(width, height, pixels)
+    maxval = int(tokens[3])
+    if magic == b"P2":
+        values = [int(v) for v in re.sub(rb"#[^\n]*\n", b" ", data[offset - 1:]).split()]
+    elif magic == b"P5":
+        values = list(data[offset:offset + width * height])
+    else:
+        raise ValueError("unsupported Netpbm format %r" % magic)
+    return Image(width, height, [v * 255 // maxval for v in values[:width * height]])
+
+
+def read_png(data):
+    """Minimal PNG decoder: non-interlaced, 8 bits per channel or palette images, no dependencies."""
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG file")
+    pos = 8
+    idat = b""
+    palette = None
+    transparency = None
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif kind == b"tRNS":
+            transparency = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+        elif kind == b"IEND":
+            break
+    if interlace:
+        raise ValueError("interlaced PNGs are not supported")
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    if depth != 8 and not (color in (0, 3) and depth in (1, 2, 4)):
+        raise ValueError("unsupported bit depth %d" % depth)
+    bpp = max(1, channels * depth // 8)
+    stride = (width * channels * depth + 7) // 8
+    raw = zlib.decompress(idat)
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        ftype = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if ftype == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif ftype == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif ftype == 3:
+                line[i] = (line[i] + (a + b) // 2) & 0xFF
+            elif ftype == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                line[i] = (line[i] + (a if pa <= pb and pa <= pc else (b if pb <= pc else c))) & 0xFF
+        rows.append(line)
+        prev = line
+    pixels = []
+    for line in rows:
+        for x in range(width):
+            if depth < 8:
+                per_byte = 8 // depth
+                v = (line[x // per_byte] >> ((per_byte - 1 - x % per_byte) * depth)) & ((1 << depth) - 1)
+                if color == 0:
+                    v = v * 255 // ((1 << depth) - 1)
+                samples, alpha = ([v], 255)
+            else:
+                samples = list(line[x * channels:(x + 1) * channels])
+                alpha = samples.pop() if color in (4, 6) else 255
+            if color == 3:
+                index = samples[0]
+                r, g, b = palette[index]
+                alpha = transparency[index] if transparency and index < len(transparency) else 255
+            elif len(samples) == 3:
+                r, g, b = samples
+            else:
+                r = g = b = samples[0]
+            luma = (r * 299 + g * 587 + b * 114) // 1000
+            # Transparent pixels are treated as white, i.e. background.
+            pixels.append((luma * alpha + 255 * (255 - alpha)) // 255)
+    return Image(width, height, pixels)
+
+
+def read_image(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] == b"\x89PNG\r\n\x1a\n":
+        return read_png(data)
+    return read_netpbm(data)
+
+
+# The same 8x8 Bayer matrix as in dither.hpp.
+BAYER = [
+    [0, 32, 8, 40, 2, 34, 10, 42],
+    [48, 16, 56, 24, 50, 18, 58, 26],
+    [12, 44, 4, 36, 14, 46, 6, 38],
+    [60, 28, 52, 20, 62, 30, 54, 22],
+    [3, 35, 11, 43, 1, 33, 9, 41],
+    [51, 19, 59, 27, 49, 17, 57, 25],
+    [15, 47, 7, 39, 13, 45, 5, 37],
+    [63, 31, 55, 23, 61, 29, 53, 21],
+]
+
+
+def to_bits(image, threshold, invert, dither):
+    """2D list of booleans, True for lit pixels. Dark pixels are lit unless inverted."""
+
+    def lit(x, y):
+        # Brightness of the pixel in terms of the display, like Dither class expects.
+        v = image.gray(x, y) if invert else 255 - image.gray(x, y)
+        t = 4 * BAYER[y & 7][x & 7] + 2 if dither == "bayer" else 255 - threshold
+        return v > t
+
+    return [[lit(x, y) for x in range(image.width)] for y in range(image.height)]
+
+
+def pages_layout(bits, width, height):
+    result = []
+    for page in range((height + 7) // 8):
+        for x in range(width):
+            b = 0
+            for i in range(8):
+                y = page * 8 + i
+                if y < height and bits[y][x]:
+                    b |= 1 << i
+            result.append(b)
+    return result
+
+
+def rowmajor_layout(bits, width, height):
+    result = []
+    for y in range(height):
+        for block in range((width + 7) // 8):
+            b = 0
+            for i in range(8):
+                x = block * 8 + i
+                if x < width and bits[y][x]:
+                    b |= 0x80 >> i
+            result.append(b)
+    return result
+
+
+def compress(data):
+    """Encodes bytes into the chunks described in compressedbitmap.hpp."""
+    out = []
+    literal = []
+
+    def flush_literal():
+        while literal:
+            part = literal[:128]
+            del literal[:128]
+            out.append(0x00 | (len(part) - 1))
+            out.extend(part)
+
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i]:
+            run += 1
+        if data[i] == 0 and run >= 2:
+            flush_literal()
+            run = min(run, 64)
+            out.append(0xC0 | (run - 1))
+        elif run >= 3:
+            flush_literal()
+            run = min(run, 65)
+            out.extend([0x80 | (run - 2), data[i]])
+        else:
+            run = 1
+            literal.append(data[i])
+        i += run
+    flush_literal()
+    return out
+
+
+def format_array(name, comment, values, width, height):
+    lines = ["// %s" % comment, "const uint8_t PROGMEM %s[] = {" % name, "\t// Width, height.", "\t%d, %d," % (width, height)]
+    for i in range(0, len(values), 16):
+        lines.append("\t" + ", ".join("0x%02X" % v for v in values[i:i + 16]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="PBM, PGM or PNG file")
+    parser.add_argument("--name", help="name of the array, derived from the file name by default")
+    parser.add_argument("--format", choices=["compressed", "pages", "rowmajor"], default="compressed")
+    parser.add_argument("--threshold", type=int, default=128, help="gray levels below this are lit (default: 128)")
+    parser.add_argument("--invert", action="store_true", help="light pixels are lit instead of dark ones")
+    parser.add_argument("--dither", choices=["threshold", "bayer"], default="threshold")
+    args = parser.parse_args()
+
+    image = read_image(args.image)
+    if image.width > 255 or image.height > 255:
+        parser.error("images should be at most 255x255 pixels")
+
+    name = args.name or re.sub(r"\W", "_", os.path.splitext(os.path.basename(args.image))[0])
+    bits = to_bits(image, args.threshold, args.invert, args.dither)
+    pages = pages_layout(bits, image.width, image.height)
+
+    if args.format == "pages":
+        values = pages
+    elif args.format == "rowmajor":
+        values = rowmajor_layout(bits, image.width, image.height)
+    else:
+        values = compress(pages)
+
+    raw_size = 2 + len(pages)
+    size = 2 + len(values)
+    comment = "'%s', %dx%d, %s: %d bytes (%d bytes raw, %.1fx)." % (
+        os.path.basename(args.image), image.width, image.height, args.format, size, raw_size, raw_size / size
+    )
+    sys.stdout.write(format_array(name, comment, values, image.width, image.height))
+    sys.stderr.write(comment + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+#
+# a21 — Arduino Toolkit.
+# Copyright (C) 2016-2018, Aleh Dzenisiuk. http://github.com/aleh/a21
+#
+
+"""
+Generates a21 fonts in the indexed Font8 format (see font8.hpp), emitting a C++ class to be stored in the flash.
+With --pages 2-4 generates fonts 16-32 pixels high for FontN (see fontn.hpp) instead.
+
+Fonts having characters beyond Latin-1 (e.g. Cyrillic, arrows, the degree sign is fine as is) are generated in the
+sparse format, which covers the Basic Multilingual Plane. To keep them small, use --used-in to include only the
+characters appearing in the string literals of the given sources, so the flash is spent only on the glyphs the project
+actually draws.
+
+The source can be either a BDF font or an existing font in any Font8 format (a header like font8fonts.hpp, use --legacy
+and --class to pick the font), which is how the built-in fonts are converted.
+
+Font8 glyphs are at most 8 pixels wide and high. In BDF fonts the glyph is placed so its baseline is FONT_ASCENT pixels
+below the top of the page; its width is the width of its bounding box, the 1px spacing is added when drawing.
+
+Example:
+    tools/a21font.py pixelstad.bdf --name Font8Pixelstad --chars 32-126 > font8pixelstad.hpp
+    tools/a21font.py a21/font8fonts.hpp --legacy --class Font8PixelstadTweaked
+    tools/a21font.py digits24.bdf --pages 3 --chars 32,45-58 --name FontDigits24 > fontdigits24.hpp
+    tools/a21font.py unifont8.bdf --used-in sketch/*.ino sketch/*.hpp --name Font8Menu > font8menu.hpp
+"""
+
+import argparse
+import os
+import re
+import sys
+
+
+class Font:
+    """Glyphs by character code, every glyph is a list of columns with the topmost pixel in the least significant bit."""
+
+    def __init__(self, name, glyphs, uppercase_only=False):
+        self.name = name
+        self.glyphs = glyphs
+        self.uppercase_only = uppercase_only
+
+
+def read_bdf(path):
+
+    glyphs = {}
+    ascent = None
+    code = None
+    bbx = None
+    dwidth = None
+    rows = None
+
+    with open(path, encoding="latin-1") as f:
+        for line in f:
+            parts = line.split()
+            if not parts:
+                continue
+            key = parts[0]
+            if rows is not None:
+                if key == "ENDCHAR":
+                    if code is not None and code >= 0:
+                        glyphs[code] = _bdf_glyph(rows, bbx, dwidth, ascent)
+                    rows = None
+                else:
+                    rows.append((int(parts[0], 16), len(parts[0]) * 4))
+            elif key == "FONT_ASCENT":
+                ascent = int(parts[1])
+            elif key == "STARTCHAR":
+                code = None
+                bbx = None
+                dwidth = None
+            elif key == "ENCODING":
+                code = int(parts[1])
+            elif key == "DWIDTH":
+                dwidth = int(parts[1])
+            elif key == "BBX":
+                bbx = [int(v) for v in parts[1:5]]
+            elif key == "BITMAP":
+                rows = []
+
+    if ascent is None:
+        raise ValueError("FONT_ASCENT is missing")
+
+    return Font(os.path.splitext(os.path.basename(path))[0], glyphs)
+
+
+def _bdf_glyph(rows, bbx, dwidth, ascent):
+
+    w, h, xoff, yoff = bbx
+    width = max(xoff + w, 0)
+    if not any(value for value, _ in rows):
+        # Like a space, the glyph has no pixels but should still occupy some room.
+        width = max((dwidth or 1) - 1, 1)
+
+    columns = [0] * width
+    top = ascent - yoff - h
+    for r, (value, bits) in enumerate(rows):
+        y = top + r
+        if y < 0:
+            continue
+        for c in range(w):
+            if value & (1 << (bits - 1 - c)):
+                x = xoff + c
+                if 0 <= x < width:
+                    columns[x] |= 1 << y
+
+    return columns
+
+
+def _c_array_values(text, class_name):
+    """The numbers of the first PROGMEM array following the given class name in a C++ header."""
+    pos = text.find("class %s" % class_name)
+    if pos < 0:
+        raise ValueError("could not find class '%s'" % class_name)
+    start = text.index("{", text.index("PROGMEM", pos))
+    end = text.index("};", start)
+    body = re.sub(r"/\*.*?\*/", "", text[start + 1:end], flags=re.S)
+    body = re.sub(r"//[^\n]*", "", body)
+    return [int(v, 0) for v in re.findall(r"\w+", body)]
+
+
+def read_legacy(path, class_name):
+    """Reads a font in either Font8 format from a C++ header."""
+
+    with open(path, encoding="utf-8") as f:
+        data = _c_array_values(f.read(), class_name)
+
+    flags = data[0]
+    glyphs = {}
+    p = 1
+    if flags & 16:
+        count = data[p]
+        p += 1
+        offsets_start = p + count * 6
+        for i in range(count):
+            first, last, index = [data[p + 2 * j] | (data[p + 2 * j + 1] << 8) for j in range(3)]
+            p += 6
+            for code in range(first, last + 1):
+                entry = offsets_start + (index + code - first) * 2
+                start = data[entry] | (data[entry + 1] << 8)
+                end = data[entry + 2] | (data[entry + 3] << 8)
+                if end > start:
+                    glyphs[code] = data[start:end]
+    elif flags & 2:
+        ranges = []
+        while data[p] != 0:
+            first, last = data[p], data[p + 1]
+            p += 2
+            offsets = [data[p + 2 * i] | (data[p + 2 * i + 1] << 8) for i in range(last - first + 2)]
+            p += len(offsets) * 2
+            ranges.append((first, offsets))
+        for first, offsets in ranges:
+            for i in range(len(offsets) - 1):
+                if offsets[i + 1] > offsets[i]:
+                    glyphs[first + i] = data[offsets[i]:offsets[i + 1]]
+    else:
+        while data[p] != 0:
+            first, last, size = data[p:p + 3]
+            p += 3
+            for code in range(first, last + 1):
+                glyphs[code] = data[p + 1:p + 1 + data[p]]
+                p += size
+
+    return Font(class_name, glyphs, uppercase_only=bool(flags & 1))
+
+
+def parse_chars(spec):
+    """A set of character codes from a list like '32-126,176'."""
+    codes = set()
+    for part in spec.split(","):
+        if "-" in part:
+            a, b = part.split("-")
+            codes.update(range(int(a, 0), int(b, 0) + 1))
+        elif part:
+            codes.add(int(part, 0))
+    return codes
+
+
+def used_codes(paths):
+    """Code points of all the characters in the string and character literals of the given C++ sources."""
+    codes = set()
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            for literal in re.findall(r'"((?:\\.|[^"\\\n])*)"|\'((?:\\.|[^\'\\\n])+)\'', f.read()):
+                text = re.sub(r"\\.", "", literal[0] or literal[1])
+                codes.update(ord(ch) for ch in text)
+    return codes
+
+
+def make_ranges(codes, max_gap):
+    """
+    Groups character codes into ranges. Small gaps are filled with missing characters when this is not more
+    expensive than starting a new range, because fewer ranges are faster to search: a missing character costs
+    an offset (2 bytes), a new range costs its header and the end offset in the indexed format (4 bytes)
+    and its entry in the sparse format (6 bytes).
+    """
+    ranges = []
+    for code in sorted(codes):
+        if ranges and code - ranges[-1][1] - 1 <= max_gap:
+            ranges[-1][1] = code
+        else:
+            ranges.append([code, code])
+    return ranges
+
+
+def char_name(code):
+    ch = chr(code)
+    if code < 32 or 127 <= code < 160 or ch in "*/" or not ch.isprintable():
+        return "%d" % code if code < 256 else "U+%04X" % code
+    return "'%s'" % ch
+
+
+def char_comment(code):
+    return "/* %3s */" % char_name(code)
+
+
+def format_font(font, class_name, source, pages=1, sparse=False):
+
+    codes = [c for c in font.glyphs if 0 < c < (0x10000 if sparse else 0x100)]
+    for code in codes:
+        columns = font.glyphs[code]
+        if pages == 1 and len(columns) > 8:
+            raise ValueError("character %d is %d pixels wide, Font8 allows 8 at most" % (code, len(columns)))
+        if len(columns) * pages > 255:
+            raise ValueError("character %d is %d pixels wide, too wide for %d pages" % (code, len(columns), pages))
+        if any(c >> (8 * pages) for c in columns):
+            raise ValueError("character %d is taller than %d pixels" % (code, 8 * pages))
+
+    if sparse:
+        ranges = make_ranges(codes, 3)
+        if len(ranges) > 255:
+            raise ValueError("too many ranges of characters (%d), 255 at most" % len(ranges))
+        header_size = 2 + 6 * len(ranges) + 2 * (sum(last - first + 1 for first, last in ranges) + 1)
+        flags = 16
+    else:
+        ranges = make_ranges(codes, 2)
+        header_size = 1 + sum(2 + 2 * (last - first + 2) for first, last in ranges) + 1
+        flags = 2
+    flags |= (1 if font.uppercase_only else 0) | ((pages - 1) << 2)
+    flags_comment = "// Flags: bit 0 - uppercase only, bit 1 - indexed format"
+    if pages > 1:
+        flags_comment += ", bits 2-3 - number of pages minus 1"
+    flags_comment += ", bit 4 - sparse format." if sparse else "."
+
+    i1 = "   \t"
+    i2 = i1 + "\t"
+    i3 = i2 + "\t"
+
+    if pages == 1:
+        lines = [
+            "/**",
+            " * 8-bit font data generated from '%s' via tools/a21font.py." % source,
+            " */",
+            "class %s {" % class_name,
+            "public:",
+            i1 + "static Font8::Data data() {",
+            i2 + "static const uint8_t PROGMEM _data[] = {",
+            i3 + flags_comment,
+            i3 + "%d," % flags,
+        ]
+    else:
+        lines = [
+            "/**",
+            " * %d-pixel font data generated from '%s' via tools/a21font.py." % (8 * pages, source),
+            " */",
+            "class %s {" % class_name,
+            "public:",
+            i1 + "static FontN::Data data() {",
+            i2 + "static const uint8_t PROGMEM _data[] = {",
+            i3 + flags_comment,
+            i3 + "%d," % flags,
+        ]
+
+    offset = header_size
+    bitmaps = []
+
+    def add_offsets(first, last):
+        nonlocal offset
+        for code in range(first, last + 1):
+            columns = font.glyphs.get(code, [])
+            lines.append(i3 + "%s %d, %d," % (char_comment(code), offset & 0xFF, offset >> 8))
+            if columns:
+                bitmaps.append((code, columns))
+            offset += len(columns) * pages
+
+    if sparse:
+        lines += [
+            "",
+            i3 + "// Number of ranges.",
+            i3 + "%d," % len(ranges),
+            "",
+            i3 + "// Ranges: first and last code points, index of the offset of the first one.",
+        ]
+        index = 0
+        for first, last in ranges:
+            values = [first & 0xFF, first >> 8, last & 0xFF, last >> 8, index & 0xFF, index >> 8]
+            lines.append(i3 + "%s, // %s to %s" % (", ".join(str(v) for v in values), char_name(first), char_name(last)))
+            index += last - first + 1
+        lines += [
+            "",
+            i3 + "// Offsets of the bitmaps of all the characters from the beginning of the font data;",
+            i3 + "// the last one marks the end of the last bitmap.",
+        ]
+        for first, last in ranges:
+            add_offsets(first, last)
+        lines.append(i3 + "/* end */ %d, %d," % (offset & 0xFF, offset >> 8))
+    else:
+        for first, last in ranges:
+            lines += [
+                "",
+                i3 + "// Range %s to %s." % (char_name(first), char_name(last)),
+                i3 + "%d, %d," % (first, last),
+                i3 + "// Offsets of the bitmaps of the characters of the range from the beginning of the font data;",
+                i3 + "// the last one marks the end of the last bitmap.",
+            ]
+            add_offsets(first, last)
+            lines.append(i3 + "/* end */ %d, %d," % (offset & 0xFF, offset >> 8))
+
+    if not sparse:
+        lines += ["", i3 + "// End of all the ranges.", i3 + "0,"]
+    lines.append("")
+    if pages == 1:
+        lines.append(i3 + "// Bitmaps, one byte per column of pixels.")
+    else:
+        lines.append(i3 + "// Bitmaps, one byte per column of pixels, %d rows of them, the topmost first." % pages)
+    for code, columns in bitmaps:
+        values = [(c >> (8 * p)) & 0xFF for p in range(pages) for c in columns]
+        lines.append(i3 + "%s %s," % (char_comment(code), ", ".join(str(v) for v in values)))
+
+    lines += [
+        i2 + "};",
+        i2 + "return _data;",
+        i1 + "}",
+        "};",
+    ]
+
+    size = offset
+    return "\n".join(lines) + "\n", size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("font", help="BDF font or a C++ header with a Font8 font (with --legacy)")
+    parser.add_argument("--legacy", action="store_true", help="read a Font8 font from a C++ header")
+    parser.add_argument("--class", dest="class_name", help="the class of the font to read with --legacy")
+    parser.add_argument("--name", help="name of the generated class, the same as the source one by default")
+    parser.add_argument("--chars", help="character codes to include, e.g. '32-126,176', all by default")
+    parser.add_argument(
+        "--used-in", nargs="+", metavar="SOURCE",
+        help="include only the characters of the string literals of these UTF-8 sources (and --chars, if any)"
+    )
+    parser.add_argument("--sparse", action="store_true", help="use the sparse format even for Latin-1 fonts")
+    parser.add_argument("--uppercase-only", action="store_true", help="lowercase letters are drawn as uppercase")
+    parser.add_argument("--pages", type=int, choices=[1, 2, 3, 4], default=1, help="height in 8-pixel pages (default: 1)")
+    args = parser.parse_args()
+
+    if args.legacy:
+        if not args.class_name:
+            parser.error("--class is required with --legacy")
+        font = read_legacy(args.font, args.class_name)
+        source = font.name
+    else:
+        font = read_bdf(args.font)
+        source = os.path.basename(args.font)
+
+    if args.chars or args.used_in:
+        codes = parse_chars(args.chars or "")
+        if args.used_in:
+            # Keeping '?' as it is drawn for the missing characters.
+            codes |= used_codes(args.used_in) | {ord("?")}
+            if args.uppercase_only or font.uppercase_only:
+                codes |= {c - ord("a") + ord("A") for c in codes if ord("a") <= c <= ord("z")}
+        font.glyphs = {c: g for c, g in font.glyphs.items() if c in codes}
+    if args.uppercase_only:
+        font.uppercase_only = True
+        font.glyphs = {c: g for c, g in font.glyphs.items() if not ord("a") <= c <= ord("z")}
+
+    name = args.name or re.sub(r"\W", "_", font.name)
+    sparse = args.sparse or any(c > 0xFF for c in font.glyphs)
+    text, size = format_font(font, name, source, args.pages, sparse)
+    sys.stdout.write(text)
+    sys.stderr.write("%s: %d characters, %d bytes.\n" % (name, len(font.glyphs), size))
+
+
+if __name__ == "__main__":
+    main()